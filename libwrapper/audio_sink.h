@@ -9,9 +9,17 @@
 #include <audio/remix_resample.h>
 #include <common_audio/resampler/include/push_resampler.h>
 #include "video/track_source.h"
+#include "video/waveform_renderer.h"
+#include "recognition_pool.h"
+#include "spsc_ring.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <utility>
 #include <limits>
+#include <thread>
+#include <vector>
 
 #include <GL/osmesa.h>
 #include <GL/glu.h>
@@ -20,34 +28,44 @@
 #define WIDTH 800
 #define HEIGHT 400
 
-#define WIDTH0 8000 // 500 msec with 16kHz
+#define WIDTH0 16000 // max recognition chunk, 1 second with 16kHz
+#define DECIMATION 3 // 48kHz input samples per 16kHz recognition sample
+#define MAX_FORMATS 8 // input formats with their own counters and resampler
 #define WIDTH1 3201
 #define WIDTH2 6400 // 8 seconds with 800Hz
 #define WIDTH3 160 // recognition frames for 8 seconds
+#define WIDTH4 WIDTH3 // max recognition frames for one chunk
+#define SILENCE_LEVEL 20 // render points below this do not show, 1/20 of the scale
+#define IDLE_POINTS 800 // render points of silence without new scores before the video idles, 1 second
 
 
 class AudioSink : public webrtc::AudioTrackSinkInterface, public Argb32ExternalVideoSource {
 public:
 
-    explicit AudioSink(): m_counter(0), recognition_thread_(rtc::Thread::Create()) {
+    AudioSink(void *session, callback2_t send2, RecognitionPool *recognition_pool, const RecognitionOptions& options):
+        m_send2(send2), m_session(session),
+        m_chunk_samples(std::max<size_t>(160, std::min<size_t>(options.chunk_samples / 160 * 160, WIDTH0))),
+        m_chunk_input_samples(m_chunk_samples * DECIMATION),
+        m_frame_samples(std::max<size_t>(1, options.frame_samples)), m_headless(options.headless), m_native_video(options.native_video), m_samples_written(0), m_samples_dropped(0), m_samples_read(0),
+        m_recognition_pending(false), m_render_seq(0), m_points_total(0), m_active_points(0), m_num_formats(0), m_last_format(0),
+        m_recognition(recognition_pool->CreateStrand()) {
         // Inputs frame for recognition
         m_inputs_frame.Mute();
         m_inputs_frame.num_channels_ = 1;
-        m_inputs_frame.sample_rate_hz_ = 16000;
-        m_inputs_frame.samples_per_channel_ = 160;
+        m_inputs_frame.sample_rate_hz_ = 48000;
+        m_inputs_frame.samples_per_channel_ = 480;
         // Render frame for video track
         m_render_frame.Mute();
         m_render_frame.num_channels_ = 1;
         m_render_frame.sample_rate_hz_ = 800;
         m_render_frame.samples_per_channel_ = 8;
-        // Setup recognition thread
-        recognition_thread_->SetName("Recognition thread", this);
-        recognition_thread_->Start();
-        recognition_thread_->BlockingCall([&] {
-            RTC_LOG(LS_WARNING) << "Thread: recognition_thread";
-        });
-        std::memset(m_outputs, 0, WIDTH3 * sizeof(float));
-        std::memset(m_offsets, 0, WIDTH3 * sizeof(float));
+        std::memset(&m_render_state, 0, sizeof m_render_state);
+        std::memset(&m_frame_state, 0, sizeof m_frame_state);
+    }
+
+    ~AudioSink() override {
+        // Queued recognition tasks refer to this sink
+        m_recognition->Close();
     }
 
     void SetDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel) {
@@ -62,100 +80,146 @@ public:
 
         RTC_LOG(LS_VERBOSE) << "OnData:" << bits_per_sample << "/" << sample_rate << "/" << number_of_channels << "/" << number_of_frames;
 
-        if (bits_per_sample != 16) {
-            return;
-        }
-        if (sample_rate != 48000) {
-            return;
-        }
-        if (number_of_channels != 1) {
-            return;
-        }
-        if (number_of_frames != 480) {
+        InputFormat& format = FindFormat(bits_per_sample, sample_rate, number_of_channels);
+        format.calls.fetch_add(1, std::memory_order_relaxed);
+
+        // The resamplers take 10 msec at a time
+        const size_t block_frames = sample_rate > 0 ? sample_rate / 100 : 0;
+        if (bits_per_sample != 16 || sample_rate % 100 != 0 || block_frames == 0 || number_of_channels == 0 ||
+            block_frames * number_of_channels > webrtc::AudioFrame::kMaxDataSizeSamples ||
+            number_of_frames % block_frames != 0) {
+            if (format.dropped.fetch_add(1, std::memory_order_relaxed) == 0) {
+                RTC_LOG(LS_WARNING) << "Unsupported audio format: " << bits_per_sample << "/" << sample_rate << "/"
+                                    << number_of_channels << "/" << number_of_frames;
+            }
             return;
         }
+        format.frames.fetch_add(number_of_frames, std::memory_order_relaxed);
 
-        webrtc::voe::RemixAndResample((const int16_t*)src_data, number_of_frames, number_of_channels, sample_rate, &m_resampler, &m_inputs_frame);
-        webrtc::voe::RemixAndResample((const int16_t*)src_data, number_of_frames, number_of_channels, sample_rate, &m_resampler, &m_render_frame);
-
-        size_t n1 = m_inputs_frame.samples_per_channel_;
-        size_t n2 = m_render_frame.samples_per_channel_;
-
-        size_t m1 = WIDTH0 - n1;
-        size_t m2 = WIDTH2 - n2;
-
-        std::memmove(m_inputs, m_inputs + n1, m1 * sizeof(int16_t));
-        std::memmove(m_points, m_points + n2, m2 * sizeof(int16_t));
-
-        const int16_t* inputs_data = m_inputs_frame.data();
-        const int16_t* render_data = m_render_frame.data();
-
-        std::memcpy(&m_inputs[m1], inputs_data, n1 * sizeof(int16_t));
-        std::memcpy(&m_points[m2], render_data, n2 * sizeof(int16_t));
+        const int16_t* src = (const int16_t*)src_data;
+        for (size_t i = 0; i < number_of_frames; i += block_frames) {
+            OnBlock(src + i * number_of_channels, sample_rate, number_of_channels, block_frames, format);
+        }
 
-        for (size_t i = 0; i < WIDTH3; i++) {
-            m_offsets[i] -= 8.0 / 6400.0;
+        if (!m_headless) {
+            ApplyResults();
         }
+    }
 
-        m_counter += 1;
-        if (m_counter >= 50) {
-            m_counter = 0;
-            if (m_data_channel) {
-                int16_t *inputs = (int16_t *)malloc(WIDTH0 * sizeof(int16_t));
-                std::memcpy(inputs, m_inputs, WIDTH0 * sizeof(int16_t));
-                recognition_thread_->PostTask([this, inputs, counter = m_counter](){RecogniseAudio(inputs, counter);});
-                // SEND TO DC
-                //std::ostringstream stringStream;
-                //stringStream << "format:" << sample_rate << "/" << number_of_channels << "/" << number_of_frames;
-                //std::string str = stringStream.str();
-                //webrtc::DataBuffer resp(rtc::CopyOnWriteBuffer(str.c_str(), str.length()), false /* binary */);
-                //m_data_channel->Send(resp);
+    // Copies of the counters of every input format seen so far.
+    std::vector<AudioFormatStats> GetFormatStats() const {
+        std::vector<AudioFormatStats> stats;
+        const size_t n = m_num_formats.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= n; i++) {
+            const InputFormat& format = i < n ? m_formats[i] : m_other_format;
+            if (i == n && format.calls.load(std::memory_order_relaxed) == 0) {
+                break;
             }
+            stats.push_back({format.bits_per_sample, format.sample_rate, format.channels,
+                             format.calls.load(std::memory_order_relaxed),
+                             format.frames.load(std::memory_order_relaxed),
+                             format.dropped.load(std::memory_order_relaxed)});
         }
+        return stats;
     }
 
-    void RecogniseAudio(int16_t *inputs, int counter) {
-        const size_t n = 10;
-        const size_t m = WIDTH3 - n;
-        float outputs[n];
-        m_send2(inputs, WIDTH0, outputs);
-        free(inputs);
-        std::memmove(m_outputs, m_outputs + n, m * sizeof(float));
-        std::memmove(m_offsets, m_offsets + n, m * sizeof(float));
-        std::memcpy(&m_outputs[m], outputs, n * sizeof(float));
-        float diff = (m_counter - counter) * (8.0 / 6400.0);
-        float shift0 = 600.0 / 6400.0;
-        float shift = 400.0 / 6400.0;
-        for (size_t i = 0; i < n; i++) {
-            m_offsets[m + i] = - diff - shift0;
+    // Runs on the recognition pool, the only reader of m_pcm and writer of m_results.
+    void RecogniseAudio() {
+        for (;;) {
+            while (m_pcm.Read(m_chunk, m_chunk_input_samples)) {
+                m_samples_read += m_chunk_samples;
+                RecognitionResult result;
+                size_t count = m_send2(m_session, m_chunk, m_chunk_input_samples, result.outputs, WIDTH4);
+                if (count == 0) {
+                    // The model still buffers context
+                    continue;
+                }
+                if (m_headless) {
+                    // Nothing draws the scores, the words go over the data channel
+                    continue;
+                }
+                result.count = std::min<size_t>(count, WIDTH4);
+                result.samples_end = m_samples_read;
+                if (!m_results.Push(result)) {
+                    RTC_LOG(LS_WARNING) << "Recognition result dropped";
+                }
+            }
+            m_recognition_pending.store(false, std::memory_order_release);
+            // A chunk completed after the last read but before the flag was
+            // cleared would not have posted a new task.
+            if (m_pcm.Size() < m_chunk_input_samples || m_recognition_pending.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
         }
-        for (size_t i = 0; i < m; i++) {
-            m_offsets[i] += shift;
+    }
+
+    // Runs on the audio thread, the only writer of m_render_state.
+    void ApplyResults() {
+        const float shift0 = 600.0 / 6400.0;
+        // Shifting the arrays by one index moves a point by 1/80 of the width
+        const float shift = 40.0 / 6400.0;
+        // Points move by 8/6400 every 10 msec (160 samples)
+        const float speed = 8.0 / 6400.0 / 160.0;
+        // Distance between neighbour frames of one chunk
+        const float spacing = shift - m_frame_samples * speed;
+        float *outputs = m_render_state.outputs;
+        float *offsets = m_render_state.offsets;
+        RecognitionResult result;
+        while (m_results.Pop(result)) {
+            const size_t n = result.count;
+            const size_t m = WIDTH3 - n;
+            BeginRenderWrite();
+            std::memmove(outputs, outputs + n, m * sizeof(float));
+            std::memmove(offsets, offsets + n, m * sizeof(float));
+            std::memcpy(&outputs[m], result.outputs, n * sizeof(float));
+            for (size_t i = 0; i < n; i++) {
+                if (result.outputs[i] > 0.1) {
+                    // A new dot
+                    m_active_points.store(m_points_total.load());
+                    break;
+                }
+            }
+            // The last frame of the chunk is anchored to the chunk end
+            float diff = (float)(m_samples_written - result.samples_end) * speed;
+            for (size_t i = 0; i < n; i++) {
+                offsets[m + i] = - diff - shift0 + (n - 1 - i) * spacing;
+            }
+            for (size_t i = 0; i < m; i++) {
+                offsets[i] += shift * n;
+            }
+            EndRenderWrite();
         }
     }
 
     Result ContextInit() override {
+        if (m_native_video) {
+            // Frames are drawn into I420 buffers, no GL context needed
+            return Result::kSuccess;
+        }
 
         RTC_LOG(LS_WARNING) << "OSmesa major version: " << OSMESA_MAJOR_VERSION;
         RTC_LOG(LS_WARNING) << "OSmesa minor version: " << OSMESA_MINOR_VERSION;
 
-        /* Create an RGBA-mode Off-Screen Mesa rendering context */
-        ctx = OSMesaCreateContextExt(GL_RGBA, 32, 0, 0, nullptr);
+        /* Create a BGRA-mode Off-Screen Mesa rendering context, its byte order
+           is what libyuv calls ARGB, so frames go to the encoder as rendered */
+        ctx = OSMesaCreateContextExt(OSMESA_BGRA, 32, 0, 0, nullptr);
         if (!ctx) {
             RTC_LOG(LS_ERROR) << "OSMesaCreateContext failed!";
             return Result::kNotInitialized;
         }
         /* Allocate the image buffer */
-        buffer = (GLfloat *)malloc(WIDTH * HEIGHT * 4 * sizeof(GLfloat));
+        buffer = (GLubyte *)malloc(WIDTH * HEIGHT * 4 * sizeof(GLubyte));
         if (!buffer) {
             RTC_LOG(LS_ERROR) << "Alloc image buffer failed!";
             return Result::kNotInitialized;
         }
         /* Bind the buffer to the context and make it current */
-        if (!OSMesaMakeCurrent(ctx, buffer, GL_FLOAT, WIDTH, HEIGHT)) {
+        if (!OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT)) {
             RTC_LOG(LS_ERROR) << "OSMesaMakeCurrent failed!";
             return Result::kNotInitialized;
         }
+        /* Top row first, like video frames */
+        OSMesaPixelStore(OSMESA_Y_UP, 0);
 
         // Program 1
 
@@ -170,8 +234,9 @@ public:
 
         attribute_coord1d = get_attrib(program1, "coord1d");
         uniform_mytexture1 = get_uniform(program1, "mytexture");
+        uniform_offset = get_uniform(program1, "offset");
 
-        if (attribute_coord1d == -1 || uniform_mytexture1 == -1) {
+        if (attribute_coord1d == -1 || uniform_mytexture1 == -1 || uniform_offset == -1) {
             RTC_LOG(LS_ERROR) << "program1 wrong!";
             return Result::kNotInitialized;
         }
@@ -218,8 +283,27 @@ public:
         }
 
         {
-            // Create the vertex buffer object
+            // Create the vertex buffer object, filled in every frame
             glGenBuffers(1, &vbo2);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo2);
+            glBufferData(GL_ARRAY_BUFFER, WIDTH3 * 2 * sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
+        }
+
+        {
+            // Create the texture of the waveform, a ring where point p of the
+            // stream is texel p % WIDTH2. Frames upload only the new points.
+            glActiveTexture(GL_TEXTURE0);
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            // The offset uniform wraps around the ring
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            // Set texture interpolation mode
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            // Start with silence
+            std::vector<GLfloat> silence(WIDTH2, 0.5);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, WIDTH2, 1, 0, GL_RED, GL_FLOAT, silence.data());
+            m_texture_points = 0;
         }
 
         {
@@ -251,6 +335,12 @@ public:
     }
 
     Result ContextFree() override {
+        if (m_native_video) {
+            return Result::kSuccess;
+        }
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &vbo1);
+        glDeleteBuffers(1, &vbo2);
         glDeleteProgram(program1);
         glDeleteProgram(program2);
         /* free the image buffer */
@@ -260,17 +350,39 @@ public:
         return Result::kSuccess;
     }
 
+    // Silence without new scores only scrolls the picture, the video source
+    // then requests fewer frames.
+    bool IsIdle() override {
+        // Active first, it never passes the total
+        const uint64_t active = m_active_points.load();
+        return m_points_total.load() - active > IDLE_POINTS;
+    }
+
     Result FrameRequested(Argb32VideoFrameRequest& frame_request) override {
 
+        ReadRenderState();
+        const RenderState& state = m_frame_state;
+
+        if (m_native_video) {
+            rtc::scoped_refptr<webrtc::I420Buffer> frame = frame_request.CreateI420Buffer(WIDTH, HEIGHT);
+            m_renderer.Render(state.points, WIDTH2, state.points_total, 400.0, state.outputs, state.offsets, WIDTH3, frame.get());
+            frame_request.CompleteRequest(frame);
+            return Result::kSuccess;
+        }
+
         glClearColor(1.0, 1.0, 1.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT);
 
         glUseProgram(program1);
 
-        // Create our datapoints
+        // Upload the points that arrived since the last frame
+        const uint64_t total = state.points_total;
+        const size_t n_new = (size_t) std::min<uint64_t>(total - m_texture_points, WIDTH2);
+        // Texels are at the same places as the points in the ring
+        const size_t first = (size_t) ((total - n_new) % WIDTH2);
         GLfloat ypoints[WIDTH2];
-        for (int i = 0; i < WIDTH2; i++) {
-            float y = (float) m_points[i] / 400.0;
+        for (size_t i = 0; i < n_new; i++) {
+            float y = (float) state.points[(first + i) % WIDTH2] / 400.0;
             if (y > 1)
                 y = 1;
             if (y < -1)
@@ -278,18 +390,16 @@ public:
             y = y / 2.0 + 0.5;
             ypoints[i] = y;
         }
-        // Create texture
-        GLuint texture_id;
         glActiveTexture(GL_TEXTURE0);
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        // Set texture wrapping mode
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // GL_CLAMP_TO_EDGE
-        // Set texture interpolation mode
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // Upload texture with our datapoints
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, WIDTH2, 1, 0, GL_RED, GL_FLOAT, ypoints);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        const size_t n_end = std::min(n_new, WIDTH2 - first);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, first, 0, n_end, 1, GL_RED, GL_FLOAT, ypoints);
+        if (n_end < n_new) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n_new - n_end, 1, GL_RED, GL_FLOAT, ypoints + n_end);
+        }
+        m_texture_points = total;
+        // The oldest point is on the left
+        glUniform1f(uniform_offset, (float) (total % WIDTH2) / WIDTH2);
 
         // Draw using the vertices in our vertex buffer object
         glBindBuffer(GL_ARRAY_BUFFER, vbo1);
@@ -309,11 +419,11 @@ public:
         point xpoints[WIDTH3];
         GLfloat xhalf = (float)WIDTH3 / 2.0;
         for (int i = 0; i < WIDTH3; i++) {
-            xpoints[i].x = (float)(i - xhalf) / xhalf + m_offsets[i] * 2.0;
-            xpoints[i].y = m_outputs[i];
+            xpoints[i].x = (float)(i - xhalf) / xhalf + state.offsets[i] * 2.0;
+            xpoints[i].y = state.outputs[i];
         }
         // Tell OpenGL to copy our array to the buffer object
-        glBufferData(GL_ARRAY_BUFFER, sizeof xpoints, xpoints, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof xpoints, xpoints);
         // Draw using the vertices in our vertex buffer object
         glEnableVertexAttribArray(attribute_coord2d);
         glVertexAttribPointer(attribute_coord2d, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -321,36 +431,11 @@ public:
 
         glFinish();
 
-        uint32_t FrameBuffer[WIDTH * HEIGHT];
-
-        const GLfloat *src = buffer;
-        uint8_t *dst = (uint8_t *)FrameBuffer;
-
-        int i, x, y;
-        for (y=HEIGHT-1; y >= 0; y--) {
-            for (x=0; x < WIDTH; x++) {
-                int r, g, b, a;
-                i = (y * WIDTH + x) * 4;
-                r = (int) (src[i+0] * 255.0);
-                g = (int) (src[i+1] * 255.0);
-                b = (int) (src[i+2] * 255.0);
-                a = (int) (src[i+3] * 255.0);
-                if (b > 255) b = 255;
-                if (g > 255) g = 255;
-                if (r > 255) r = 255;
-                if (a > 255) a = 255;
-                dst[0] = (uint8_t)b;
-                dst[1] = (uint8_t)g;
-                dst[2] = (uint8_t)r;
-                dst[3] = (uint8_t)a;
-                dst += 4;
-            }
-        }
-
         Argb32VideoFrame frame_view{};
         frame_view.width_ = WIDTH;
         frame_view.height_ = HEIGHT;
-        frame_view.argb32_data_ = FrameBuffer;
+        // The encoder converts straight from the render target
+        frame_view.argb32_data_ = buffer;
         frame_view.stride_ = WIDTH * 4;
 
         frame_request.CompleteRequest(frame_view);
@@ -360,17 +445,189 @@ public:
     callback2_t m_send2;
 
 protected:
-    size_t m_counter;
-    int16_t m_inputs[WIDTH0];
-    int16_t m_points[WIDTH2];
-    float m_outputs[WIDTH3];
-    float m_offsets[WIDTH3];
+    // Counters and resampler of one input format. Only the audio thread
+    // writes, GetFormatStats() may read from any thread.
+    struct InputFormat {
+        int bits_per_sample = 0;
+        int sample_rate = 0;
+        size_t channels = 0;
+        // Remixes and resamples 10 msec of this format to 48kHz mono
+        webrtc::PushResampler<int16_t> resampler;
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    InputFormat& FindFormat(int bits_per_sample, int sample_rate, size_t channels) {
+        auto matches = [&](const InputFormat& format) {
+            return format.bits_per_sample == bits_per_sample && format.sample_rate == sample_rate &&
+                   format.channels == channels;
+        };
+        // Almost every call has the format of the previous one
+        const size_t n = m_num_formats.load(std::memory_order_relaxed);
+        if (m_last_format < n && matches(m_formats[m_last_format])) {
+            return m_formats[m_last_format];
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (matches(m_formats[i])) {
+                m_last_format = i;
+                return m_formats[i];
+            }
+        }
+        if (n == MAX_FORMATS) {
+            return m_other_format;
+        }
+        RTC_LOG(LS_INFO) << "New audio format: " << bits_per_sample << "/" << sample_rate << "/" << channels;
+        InputFormat& format = m_formats[n];
+        format.bits_per_sample = bits_per_sample;
+        format.sample_rate = sample_rate;
+        format.channels = channels;
+        m_num_formats.store(n + 1, std::memory_order_release);
+        m_last_format = n;
+        return format;
+    }
+
+    // Handles 10 msec of audio in any supported format.
+    void OnBlock(const int16_t* src, int sample_rate, size_t channels, size_t frames, InputFormat& format) {
+        if (!m_headless) {
+            webrtc::voe::RemixAndResample(src, frames, channels, sample_rate, &m_resampler, &m_render_frame);
+
+            size_t n2 = m_render_frame.samples_per_channel_;
+
+            const int16_t* render_data = m_render_frame.data();
+
+            BeginRenderWrite();
+
+            for (size_t i = 0; i < n2; i++) {
+                m_render_state.points[(m_render_state.points_total + i) % WIDTH2] = render_data[i];
+            }
+            m_render_state.points_total += n2;
+            for (size_t i = 0; i < WIDTH3; i++) {
+                m_render_state.offsets[i] -= 8.0 / 6400.0;
+            }
+
+            EndRenderWrite();
+
+            const uint64_t total = m_points_total.fetch_add(n2, std::memory_order_relaxed) + n2;
+            for (size_t i = 0; i < n2; i++) {
+                if (std::abs(render_data[i]) > SILENCE_LEVEL) {
+                    m_active_points.store(total);
+                    break;
+                }
+            }
+        }
+
+        if (m_data_channel) {
+            // The recognizer takes 48kHz mono as it is, anything else is
+            // converted with the resampler of its format first.
+            const int16_t* inputs_data = src;
+            if (sample_rate != 48000 || channels != 1) {
+                webrtc::voe::RemixAndResample(src, frames, channels, sample_rate, &format.resampler, &m_inputs_frame);
+                inputs_data = m_inputs_frame.data();
+            }
+            // The recognizer converts and resamples the 48kHz samples in one
+            // pass straight into its input, counters are in 16kHz samples.
+            const size_t n1 = 480 / DECIMATION;
+            if (m_pcm.Write(inputs_data, 480)) {
+                m_samples_written += n1;
+            } else {
+                // Recognition is more than a whole ring behind, keep the stream
+                // consistent by skipping this frame.
+                m_samples_dropped += n1;
+                RTC_LOG(LS_WARNING) << "Recognition lags behind, dropped samples: " << m_samples_dropped;
+            }
+            if (m_pcm.Size() >= m_chunk_input_samples && !m_recognition_pending.exchange(true, std::memory_order_acq_rel)) {
+                // Captures only this, so the task fits into std::function without a heap allocation
+                m_recognition->PostTask([this]() { RecogniseAudio(); });
+            }
+        }
+    }
+
+    // Audio thread, around every change of m_render_state. The sequence is odd
+    // while a change is in progress.
+    void BeginRenderWrite() {
+        m_render_seq.store(m_render_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndRenderWrite() {
+        m_render_seq.store(m_render_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Capture thread, copies m_render_state to m_frame_state and retries if the
+    // audio thread changed it meanwhile.
+    void ReadRenderState() {
+        for (;;) {
+            const uint32_t seq = m_render_seq.load(std::memory_order_acquire);
+            if (seq & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memcpy(&m_frame_state, &m_render_state, sizeof m_render_state);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_render_seq.load(std::memory_order_relaxed) == seq) {
+                return;
+            }
+        }
+    }
+
+    // Everything a video frame shows
+    struct RenderState {
+        // Ring of the last WIDTH2 render points, point p at p % WIDTH2
+        int16_t points[WIDTH2];
+        uint64_t points_total;
+        float outputs[WIDTH3];
+        float offsets[WIDTH3];
+    };
+
+    struct RecognitionResult {
+        float outputs[WIDTH4];
+        size_t count;
+        // Position of the chunk end in the sample stream
+        uint64_t samples_end;
+    };
+
+    void *m_session;
+    size_t m_chunk_samples;
+    size_t m_chunk_input_samples;
+    size_t m_frame_samples;
+    // No video track renders this sink
+    bool m_headless;
+    // Draws I420 frames without OpenGL
+    bool m_native_video;
+    // Audio thread -> recognition, about 2.7 seconds of 48kHz audio
+    SpscRing<int16_t, 131072> m_pcm;
+    // Recognition -> audio thread
+    SpscRing<RecognitionResult, 32> m_results;
+    uint64_t m_samples_written;
+    uint64_t m_samples_dropped;
+    // Owned by the recognition side
+    int16_t m_chunk[WIDTH0 * DECIMATION];
+    uint64_t m_samples_read;
+    std::atomic<bool> m_recognition_pending;
+    // Written by the audio thread under m_render_seq
+    RenderState m_render_state;
+    std::atomic<uint32_t> m_render_seq;
+    // Copy the capture thread draws from
+    RenderState m_frame_state;
+    // Render points since the start, for IsIdle()
+    std::atomic<uint64_t> m_points_total;
+    // m_points_total at the last audible points or new dot
+    std::atomic<uint64_t> m_active_points;
     rtc::scoped_refptr<webrtc::DataChannelInterface> m_data_channel;
+    // Resamples to the 800Hz render frame
     webrtc::PushResampler<int16_t> m_resampler;
+    // 48kHz mono input of the recognizer, unused on the fast path
     webrtc::AudioFrame m_inputs_frame;
+    InputFormat m_formats[MAX_FORMATS];
+    // Shared by the formats that do not fit m_formats
+    InputFormat m_other_format;
+    std::atomic<size_t> m_num_formats;
+    size_t m_last_format;
     webrtc::AudioFrame m_render_frame;
 
-    GLfloat *buffer;
+    // BGRA render target, top row first
+    GLubyte *buffer;
     OSMesaContext ctx;
 
     GLuint program1;
@@ -380,12 +637,20 @@ protected:
     GLint attribute_coord2d;
 
     GLint uniform_mytexture1;
+    GLint uniform_offset;
     GLint uniform_mytexture2;
 
     GLuint vbo1;
     GLuint vbo2;
 
-    std::unique_ptr<rtc::Thread> recognition_thread_;
+    GLuint texture;
+    // Render points in texture
+    uint64_t m_texture_points;
+
+    WaveformRenderer m_renderer;
+
+    // Recognition tasks of this sink run in order on the shared pool
+    std::shared_ptr<RecognitionPool::Strand> m_recognition;
 };
 
 #endif //WEBRTC_WRAPPER_AUDIO_SINK_H
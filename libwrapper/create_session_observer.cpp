@@ -33,7 +33,7 @@ void CreateSessionDescriptionObserver::OnSuccess(webrtc::SessionDescriptionInter
     message_object.Accept(writer);
     std::string payload = strbuf.GetString();
     if (m_send) {
-        m_send(payload.c_str());
+        m_send(m_session, payload.c_str());
     } else {
         RTC_LOG(LS_INFO) << "WARNING: empty callback";
     }
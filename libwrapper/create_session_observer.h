@@ -16,7 +16,7 @@
 class CreateSessionDescriptionObserver : public webrtc::CreateSessionDescriptionObserver {
 public:
 
-    explicit CreateSessionDescriptionObserver(rtc::scoped_refptr<webrtc::PeerConnectionInterface> &pc, callback_t send): m_pc(pc), m_send(send) {}
+    explicit CreateSessionDescriptionObserver(rtc::scoped_refptr<webrtc::PeerConnectionInterface> &pc, void *session, callback_t send): m_pc(pc), m_session(session), m_send(send) {}
 
     void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
 
@@ -25,6 +25,7 @@ public:
 private:
     rtc::scoped_refptr<webrtc::SetSessionDescriptionObserver> m_observer;
     rtc::scoped_refptr<webrtc::PeerConnectionInterface> m_pc;
+    void *m_session;
     callback_t m_send;
 };
 
@@ -15,14 +15,17 @@ void PeerConnectionObserver::OnAddStream(rtc::scoped_refptr<webrtc::MediaStreamI
         auto track = audioTracks.at(0);
         RTC_LOG(LS_INFO) << "Create AudioSink: " << track->id();
         track->AddSink(m_audio_sink.get());
+        m_audio_track = track;
     }
 }
 
 // Callback for when the data channel is successfully created.
 void PeerConnectionObserver::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
     RTC_LOG(LS_INFO) << "OnDataChannel";
-    m_data_channel = channel;
-    m_audio_sink->m_send2 = m_send2;
+    {
+        std::lock_guard<std::mutex> lock(m_data_channel_lock);
+        m_data_channel = channel;
+    }
     m_audio_sink->SetDataChannel(channel);
     m_data_channel->RegisterObserver(&m_data_channel_observer);
 }
@@ -55,5 +58,5 @@ void PeerConnectionObserver::OnIceCandidate(const webrtc::IceCandidateInterface*
     message.Accept(writer);
 
     std::string json = buffer.GetString();
-    m_send(json.c_str());
+    m_send(m_session, json.c_str());
 }
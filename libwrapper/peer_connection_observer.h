@@ -5,6 +5,8 @@
 #ifndef PEER_CONNECTION_OBSERVER_H
 #define PEER_CONNECTION_OBSERVER_H
 
+#include <mutex>
+
 #include <api/peer_connection_interface.h>
 #include "wrapper.h"
 #include "audio_sink.h"
@@ -14,9 +16,15 @@
 class PeerConnectionObserver : public webrtc::PeerConnectionObserver {
 public:
 
-    PeerConnectionObserver(): m_audio_sink(std::make_shared<AudioSink>()), m_data_channel(nullptr) {}
+    PeerConnectionObserver(void *session, callback_t send, callback2_t send2, RecognitionPool *recognition_pool, const RecognitionOptions& options):
+        m_session(session), m_send(send), m_send2(send2),
+        m_audio_sink(std::make_shared<AudioSink>(session, send2, recognition_pool, options)), m_data_channel(nullptr) {}
 
     ~PeerConnectionObserver() {
+        if (m_audio_track) {
+            m_audio_track->RemoveSink(m_audio_sink.get());
+            m_audio_track = nullptr;
+        }
         if (m_data_channel) {
             m_data_channel->UnregisterObserver();
             m_data_channel.release();
@@ -30,17 +38,27 @@ public:
     void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override;
     void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
 
+    // The data channel the client opened, null until it arrives. May be called
+    // from any thread.
+    rtc::scoped_refptr<webrtc::DataChannelInterface> GetDataChannel() {
+        std::lock_guard<std::mutex> lock(m_data_channel_lock);
+        return m_data_channel;
+    }
+
     void OnRenegotiationNeeded() override {}
     void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState /* new_state */) override {}
     void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState /* new_state */) override {}
     void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState /* new_state */) override {}
 
+    void *m_session;
     callback_t m_send;
     callback2_t m_send2;
 
     std::shared_ptr<AudioSink> m_audio_sink;
 
 private:
+    rtc::scoped_refptr<webrtc::AudioTrackInterface> m_audio_track;
+    std::mutex m_data_channel_lock;
     rtc::scoped_refptr<webrtc::DataChannelInterface> m_data_channel;
     DataChannelObserver m_data_channel_observer;
 };
@@ -0,0 +1,197 @@
+#include "recognition_pool.h"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <rtc_base/logging.h>
+
+
+void RecognitionPool::Strand::PostTask(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_closed) {
+            return;
+        }
+        m_tasks.emplace_back(std::move(task), Clock::now());
+        m_pool->m_queue_depth.fetch_add(1, std::memory_order_relaxed);
+        if (m_scheduled) {
+            return;
+        }
+        m_scheduled = true;
+    }
+    // Spread new work over the workers, stealing evens out the rest.
+    size_t worker_index = m_pool->m_next_worker.fetch_add(1, std::memory_order_relaxed);
+    m_pool->Schedule(shared_from_this(), worker_index % m_pool->m_workers.size());
+}
+
+void RecognitionPool::Strand::Close() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_closed = true;
+    m_pool->m_queue_depth.fetch_sub(m_tasks.size(), std::memory_order_relaxed);
+    m_tasks.clear();
+    m_idle.wait(lock, [this]() { return !m_running; });
+}
+
+bool RecognitionPool::Strand::RunNext() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_tasks.empty()) {
+            m_scheduled = false;
+            return false;
+        }
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_tasks.front().second);
+        uint64_t wait_us = wait.count();
+        m_pool->m_wait_total_us.fetch_add(wait_us, std::memory_order_relaxed);
+        uint64_t max_us = m_pool->m_wait_max_us.load(std::memory_order_relaxed);
+        while (wait_us > max_us && !m_pool->m_wait_max_us.compare_exchange_weak(max_us, wait_us)) {}
+        m_pool->m_tasks.fetch_add(1, std::memory_order_relaxed);
+        m_pool->m_queue_depth.fetch_sub(1, std::memory_order_relaxed);
+        task = std::move(m_tasks.front().first);
+        m_tasks.pop_front();
+        m_running = true;
+    }
+
+    task();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_running = false;
+    if (m_closed || m_tasks.empty()) {
+        m_scheduled = false;
+        m_idle.notify_all();
+        return false;
+    }
+    return true;
+}
+
+RecognitionPool::RecognitionPool(size_t num_threads):
+    m_next_worker(0), m_scheduled_strands(0), m_stop(false),
+    m_queue_depth(0), m_tasks(0), m_wait_total_us(0), m_wait_max_us(0) {
+
+    std::vector<int> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &cpu_set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    if (num_threads == 0) {
+        num_threads = cpus.size() > 1 ? cpus.size() - 1 : 1;
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        // Leave the first core to the WebRTC threads when there are enough
+        int cpu = cpus.empty() ? -1 : cpus[(i + 1) % cpus.size()];
+        m_workers[i]->thread = std::thread(&RecognitionPool::WorkerLoop, this, i, cpu);
+    }
+
+    RTC_LOG(LS_WARNING) << "Recognition pool started with " << num_threads << " threads";
+}
+
+RecognitionPool::~RecognitionPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_lock);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+std::shared_ptr<RecognitionPool::Strand> RecognitionPool::CreateStrand() {
+    return std::make_shared<Strand>(this);
+}
+
+RecognitionPool::Stats RecognitionPool::GetStats() const {
+    Stats stats;
+    stats.threads = m_workers.size();
+    stats.queue_depth = m_queue_depth.load(std::memory_order_relaxed);
+    stats.tasks = m_tasks.load(std::memory_order_relaxed);
+    uint64_t wait_total_us = m_wait_total_us.load(std::memory_order_relaxed);
+    stats.avg_wait_ms = stats.tasks ? wait_total_us / 1000.0 / stats.tasks : 0.0;
+    stats.max_wait_ms = m_wait_max_us.load(std::memory_order_relaxed) / 1000.0;
+    return stats;
+}
+
+void RecognitionPool::Schedule(std::shared_ptr<Strand> strand, size_t worker_index) {
+    // Counted before it is visible, a worker may pop and uncount it right away.
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_lock);
+        m_scheduled_strands++;
+    }
+    {
+        Worker& worker = *m_workers[worker_index];
+        std::lock_guard<std::mutex> lock(worker.lock);
+        worker.queue.push_back(std::move(strand));
+    }
+    m_wakeup.notify_one();
+}
+
+bool RecognitionPool::TryPop(size_t worker_index, std::shared_ptr<Strand>& strand) {
+    // Own queue first, oldest strand first
+    {
+        Worker& worker = *m_workers[worker_index];
+        std::lock_guard<std::mutex> lock(worker.lock);
+        if (!worker.queue.empty()) {
+            strand = std::move(worker.queue.front());
+            worker.queue.pop_front();
+            return true;
+        }
+    }
+    // Steal the newest strand of another worker
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        Worker& victim = *m_workers[(worker_index + i) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.queue.empty()) {
+            strand = std::move(victim.queue.back());
+            victim.queue.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void RecognitionPool::WorkerLoop(size_t worker_index, int cpu) {
+    if (cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            RTC_LOG(LS_WARNING) << "Failed to pin recognition worker " << worker_index << " to cpu " << cpu;
+        }
+    }
+
+    while (true) {
+        std::shared_ptr<Strand> strand;
+        if (TryPop(worker_index, strand)) {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_lock);
+                m_scheduled_strands--;
+            }
+            // One task per turn keeps the sessions fair, a busy strand goes to
+            // the back of the queue.
+            if (strand->RunNext()) {
+                Schedule(std::move(strand), worker_index);
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleep_lock);
+        if (m_stop) {
+            return;
+        }
+        m_wakeup.wait(lock, [this]() { return m_stop || m_scheduled_strands > 0; });
+        if (m_stop) {
+            return;
+        }
+    }
+}
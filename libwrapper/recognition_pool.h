@@ -0,0 +1,97 @@
+#ifndef WEBRTC_WRAPPER_RECOGNITION_POOL_H
+#define WEBRTC_WRAPPER_RECOGNITION_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads shared by all sessions. Each worker is pinned to
+// its own core and owns a queue; idle workers steal from the other queues.
+//
+// Work is posted through a Strand. Tasks of one strand run one at a time and in
+// the order they were posted, because the streaming state of a session is
+// sequential. Different strands run in parallel.
+class RecognitionPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        size_t threads;
+        // Tasks posted but not started yet.
+        size_t queue_depth;
+        // Tasks started since the pool was created.
+        uint64_t tasks;
+        // Time between posting a task and starting it.
+        double avg_wait_ms;
+        double max_wait_ms;
+    };
+
+    class Strand : public std::enable_shared_from_this<Strand> {
+    public:
+        explicit Strand(RecognitionPool *pool): m_pool(pool) {}
+
+        void PostTask(std::function<void()> task);
+
+        // Drops the queued tasks and waits for the running one. No task of
+        // this strand runs after it returns.
+        void Close();
+
+    private:
+        friend class RecognitionPool;
+
+        // Runs the oldest task, returns true if the strand has to be scheduled
+        // again.
+        bool RunNext();
+
+        RecognitionPool *m_pool;
+        std::mutex m_lock;
+        std::condition_variable m_idle;
+        std::deque<std::pair<std::function<void()>, Clock::time_point>> m_tasks;
+        bool m_scheduled = false;
+        bool m_running = false;
+        bool m_closed = false;
+    };
+
+    // num_threads == 0 picks one thread per available core minus one, which is
+    // left for the WebRTC threads.
+    explicit RecognitionPool(size_t num_threads = 0);
+
+    ~RecognitionPool();
+
+    std::shared_ptr<Strand> CreateStrand();
+
+    Stats GetStats() const;
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::shared_ptr<Strand>> queue;
+        std::thread thread;
+    };
+
+    void Schedule(std::shared_ptr<Strand> strand, size_t worker_index);
+    bool TryPop(size_t worker_index, std::shared_ptr<Strand>& strand);
+    void WorkerLoop(size_t worker_index, int cpu);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<size_t> m_next_worker;
+
+    std::mutex m_sleep_lock;
+    std::condition_variable m_wakeup;
+    size_t m_scheduled_strands;
+    bool m_stop;
+
+    std::atomic<size_t> m_queue_depth;
+    std::atomic<uint64_t> m_tasks;
+    std::atomic<uint64_t> m_wait_total_us;
+    std::atomic<uint64_t> m_wait_max_us;
+};
+
+#endif //WEBRTC_WRAPPER_RECOGNITION_POOL_H
@@ -0,0 +1,78 @@
+#ifndef WEBRTC_WRAPPER_SPSC_RING_H
+#define WEBRTC_WRAPPER_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Fixed capacity single-producer/single-consumer ring. All storage is inside the
+// object, so neither side ever allocates. One thread may only write and one
+// thread may only read; Size() is exact on the reading side and a lower bound
+// of the free space on the writing side.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing(): m_head(0), m_tail(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+    size_t Size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    // Writes all n items or nothing, returns false if there is no room.
+    bool Write(const T *items, size_t n) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        if (Capacity - (tail - head) < n) {
+            return false;
+        }
+        size_t offset = tail & (Capacity - 1);
+        size_t first = std::min(n, Capacity - offset);
+        std::copy(items, items + first, m_items + offset);
+        std::copy(items + first, items + n, m_items);
+        m_tail.store(tail + n, std::memory_order_release);
+        return true;
+    }
+
+    // Reads exactly n items or nothing, returns false if fewer are available.
+    bool Read(T *items, size_t n) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        if (tail - head < n) {
+            return false;
+        }
+        size_t offset = head & (Capacity - 1);
+        size_t first = std::min(n, Capacity - offset);
+        std::copy(m_items + offset, m_items + offset + first, items);
+        std::copy(m_items, m_items + (n - first), items + first);
+        m_head.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    bool Push(const T& item) {
+        return Write(&item, 1);
+    }
+
+    bool Pop(T& item) {
+        return Read(&item, 1);
+    }
+
+private:
+    // Indices grow monotonically and are wrapped on access. Each one lives on
+    // its own cache line so the two sides do not invalidate each other.
+    alignas(64) std::atomic<uint64_t> m_head;
+    alignas(64) std::atomic<uint64_t> m_tail;
+    alignas(64) T m_items[Capacity];
+};
+
+#endif //WEBRTC_WRAPPER_SPSC_RING_H
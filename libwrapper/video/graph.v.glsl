@@ -3,10 +3,12 @@
 attribute float coord1d;
 varying vec4 f_color;
 uniform sampler2D mytexture;
+// Texture coordinate of the oldest point
+uniform float offset;
 
 void main(void) {
 	float x = coord1d;
-    float x1 = x / 2.0 + 0.5;
+    float x1 = x / 2.0 + 0.5 + offset;
     float t = texture(mytexture, vec2(x1, 0)).r;
 	float y = (t - 0.5) * 2.0;
     gl_Position = vec4(x, y, 0.0, 1.0);
@@ -1,9 +1,14 @@
 #include "track_source.h"
 #include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <cmath>
 
 
 constexpr const size_t kMaxPendingRequestCount = 64;
 
+constexpr const int64_t kFrameRateWindowMs = 1000;
+
 RefPtr<ExternalVideoTrackSource> ExternalVideoTrackSource::createFromArgb32(
     std::shared_ptr<Argb32ExternalVideoSource> video_source) {
   // Note: Video track sources always start already capturing; there is no
@@ -52,43 +57,77 @@ void ExternalVideoTrackSource::StartCapture() {
   capture_thread_->PostDelayedTask([&]{OnMessage();}, webrtc::TimeDelta::Millis(10));
 }
 
-Result ExternalVideoTrackSource::CompleteRequest(
-    uint32_t request_id,
-    int64_t timestamp_ms,
-    const Argb32VideoFrame& frame_view) {
-  // Validate pending request ID and retrieve frame timestamp
-  int64_t timestamp_ms_original = -1;
-  {
-    rtc::CritScope lock(&request_lock_);
-    for (auto it = pending_requests_.begin(); it != pending_requests_.end(); ++it) {
-      if (it->first == request_id) {
-        timestamp_ms_original = it->second;
-        // Remove outdated requests, including current one
-        ++it;
-        pending_requests_.erase(pending_requests_.begin(), it);
-        break;
-      }
-    }
-    if (timestamp_ms_original < 0) {
-      return Result::kInvalidParameter;
+int64_t ExternalVideoTrackSource::TakePendingRequest(uint32_t request_id) {
+  rtc::CritScope lock(&request_lock_);
+  for (auto it = pending_requests_.begin(); it != pending_requests_.end(); ++it) {
+    if (it->first == request_id) {
+      int64_t timestamp_ms = it->second;
+      // Remove outdated requests, including current one
+      ++it;
+      pending_requests_.erase(pending_requests_.begin(), it);
+      return timestamp_ms;
     }
   }
+  return -1;
+}
 
-  // Apply user override if any
-  if (timestamp_ms != timestamp_ms_original) {
-    timestamp_ms = timestamp_ms_original;
+void ExternalVideoTrackSource::DispatchBuffer(
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer,
+    int64_t timestamp_ms) {
+  // Apply the resolution and frame rate the sinks want
+  int out_width, out_height, crop_width, crop_height, crop_x, crop_y;
+  if (!GetSourceImpl()->AdaptCapturedFrame(
+          buffer->width(), buffer->height(),
+          timestamp_ms * rtc::kNumMicrosecsPerMillisec, &out_width,
+          &out_height, &crop_width, &crop_height, &crop_x, &crop_y)) {
+    return;
+  }
+  if (out_width != buffer->width() || out_height != buffer->height()) {
+    buffer = buffer->CropAndScale(crop_x, crop_y, crop_width, crop_height,
+                                  out_width, out_height);
   }
-
   // Create and dispatch the video frame
   webrtc::VideoFrame frame{
       webrtc::VideoFrame::Builder()
-          .set_video_frame_buffer(adapter_->FillBuffer(frame_view))
+          .set_video_frame_buffer(buffer)
           .set_timestamp_ms(timestamp_ms)
           .build()};
   GetSourceImpl()->DispatchFrame(frame);
+  frames_dispatched_.fetch_add(1);
+}
+
+Result ExternalVideoTrackSource::CompleteRequest(
+    uint32_t request_id,
+    int64_t timestamp_ms,
+    const Argb32VideoFrame& frame_view) {
+  // Validate pending request ID and retrieve frame timestamp. The original
+  // timestamp overrides the one of the caller.
+  timestamp_ms = TakePendingRequest(request_id);
+  if (timestamp_ms < 0) {
+    return Result::kInvalidParameter;
+  }
+  DispatchBuffer(adapter_->FillBuffer(frame_view), timestamp_ms);
+  return Result::kSuccess;
+}
+
+Result ExternalVideoTrackSource::CompleteRequest(
+    uint32_t request_id,
+    int64_t timestamp_ms,
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer) {
+  timestamp_ms = TakePendingRequest(request_id);
+  if (timestamp_ms < 0 || !buffer) {
+    return Result::kInvalidParameter;
+  }
+  DispatchBuffer(std::move(buffer), timestamp_ms);
   return Result::kSuccess;
 }
 
+rtc::scoped_refptr<webrtc::I420Buffer> ExternalVideoTrackSource::CreateI420Buffer(
+    int width,
+    int height) {
+  return adapter_->CreateI420Buffer(width, height);
+}
+
 void ExternalVideoTrackSource::StopCapture() {
   CustomTrackSourceAdapter* const src = GetSourceImpl();
   if (src->state_ != SourceState::kEnded) {
@@ -125,11 +164,41 @@ void ExternalVideoTrackSource::OnMessage() {
   }
   adapter_->RequestFrame(*this, request_id, now);
 
-  // Schedule a new request for 30ms from now
-  capture_thread_->PostDelayedTask([&]{OnMessage();}, webrtc::TimeDelta::Millis(30));
+  // Update the frame rate once per window
+  const uint32_t frames = frames_dispatched_.load();
+  if (frame_rate_window_ms_ < 0) {
+    frame_rate_window_ms_ = now;
+    frame_rate_window_frames_ = frames;
+  } else if (now - frame_rate_window_ms_ >= kFrameRateWindowMs) {
+    frame_rate_.store((frames - frame_rate_window_frames_) * 1000.0f /
+                      (now - frame_rate_window_ms_));
+    frame_rate_window_ms_ = now;
+    frame_rate_window_frames_ = frames;
+  }
+
+  // Schedule the next request, later while the source is idle, and no sooner
+  // than the sinks want frames
+  int64_t interval_ms =
+      adapter_->IsIdle() ? kIdleFrameIntervalMs : kFrameIntervalMs;
+  const float max_framerate = GetSourceImpl()->GetMaxFramerate();
+  if (max_framerate > 0 && max_framerate * interval_ms < 1000) {
+    interval_ms = static_cast<int64_t>(std::ceil(1000 / max_framerate));
+  }
+  capture_thread_->PostDelayedTask([&]{OnMessage();}, webrtc::TimeDelta::Millis(interval_ms));
 }
 
 Result Argb32VideoFrameRequest::CompleteRequest(const Argb32VideoFrame& frame_view) {
   auto impl = static_cast<ExternalVideoTrackSource*>(&track_source_);
   return impl->CompleteRequest(request_id_, timestamp_ms_, frame_view);
 }
+
+rtc::scoped_refptr<webrtc::I420Buffer> Argb32VideoFrameRequest::CreateI420Buffer(
+    int width,
+    int height) {
+  return track_source_.CreateI420Buffer(width, height);
+}
+
+Result Argb32VideoFrameRequest::CompleteRequest(
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer) {
+  return track_source_.CompleteRequest(request_id_, timestamp_ms_, std::move(buffer));
+}
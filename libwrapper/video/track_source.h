@@ -1,6 +1,8 @@
 #ifndef WEBRTC_WRAPPER_TRACK_SOURCE_H
 #define WEBRTC_WRAPPER_TRACK_SOURCE_H
 
+#include <atomic>
+
 #include "refptr.h"
 #include "ref_counted_base.h"
 
@@ -10,6 +12,7 @@
 #include "rtc_base/deprecated/recursive_critical_section.h"
 
 #include "api/video/i420_buffer.h"
+#include "common_video/include/video_frame_buffer_pool.h"
 // libyuv from WebRTC repository for color conversion
 #include "libyuv.h"
 
@@ -38,6 +41,24 @@ struct Argb32VideoFrame {
 struct CustomTrackSourceAdapter : public rtc::AdaptedVideoTrackSource {
   void DispatchFrame(const webrtc::VideoFrame& frame) { OnFrame(frame); }
 
+  /// Size of a captured frame after adaptation to the |VideoSinkWants| of the
+  /// sinks. Returns false if no sink wants the frame.
+  bool AdaptCapturedFrame(int width,
+                          int height,
+                          int64_t time_us,
+                          int* out_width,
+                          int* out_height,
+                          int* crop_width,
+                          int* crop_height,
+                          int* crop_x,
+                          int* crop_y) {
+    return AdaptFrame(width, height, time_us, out_width, out_height,
+                      crop_width, crop_height, crop_x, crop_y);
+  }
+
+  /// Highest frame rate the sinks want, infinity if they set no limit.
+  float GetMaxFramerate() { return video_adapter()->GetMaxFramerate(); }
+
   // VideoTrackSourceInterface
   bool is_screencast() const override { return false; }
   absl::optional<bool> needs_denoising() const override {
@@ -98,6 +119,14 @@ struct Argb32VideoFrameRequest {
   /// Complete the request by making the track source consume the given video
   /// frame and have it deliver the frame to all its video tracks.
   Result CompleteRequest(const Argb32VideoFrame& frame_view);
+
+  /// Get a recycled I420 buffer of the track source, for sources that draw
+  /// I420 frames themselves and complete the request with them.
+  rtc::scoped_refptr<webrtc::I420Buffer> CreateI420Buffer(int width,
+                                                          int height);
+
+  /// Complete the request with a frame the source produced in I420 already.
+  Result CompleteRequest(rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer);
 };
 
 /// Custom video source producing video frames encoded in ARGB 32-bit-per-pixel
@@ -120,6 +149,12 @@ class Argb32ExternalVideoSource {
   virtual Result ContextFree() {
     return Result::kSuccess;
   };
+  /// Whether the picture changes too little to be worth the full frame rate,
+  /// for example during silence. Polled on the capture thread before each
+  /// request.
+  virtual bool IsIdle() {
+    return false;
+  };
 };
 
 /// Adapter for the frame buffer of an external video track source,
@@ -127,8 +162,12 @@ class Argb32ExternalVideoSource {
 /// Buffer adapter for a 32-bit ARGB video frame.
 class Argb32BufferAdapter {
  public:
+  /// Frames in flight in the encoder pipeline, more are allocated on demand.
+  static constexpr size_t kMaxPooledBuffers = 8;
+
   Argb32BufferAdapter(std::shared_ptr<Argb32ExternalVideoSource> video_source)
-      : video_source_(video_source) {}
+      : video_source_(video_source),
+        buffer_pool_(/* zero_initialize */ false, kMaxPooledBuffers) {}
   /// Request a new video frame with the specified request ID.
   Result RequestFrame(ExternalVideoTrackSource& track_source,
                       std::uint32_t request_id,
@@ -143,15 +182,30 @@ class Argb32BufferAdapter {
   Result ContextFree() {
     return video_source_->ContextFree();
   };
-  /// Allocate a new video frame buffer with a video frame received from a
+  bool IsIdle() {
+    return video_source_->IsIdle();
+  };
+  /// Get an I420 buffer from the pool, buffers return to it once the encoder
+  /// releases the frame. Only called on the capture thread.
+  rtc::scoped_refptr<webrtc::I420Buffer> CreateI420Buffer(int width,
+                                                          int height) {
+    rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+        buffer_pool_.CreateI420Buffer(width, height);
+    if (!buffer) {
+      // All pooled buffers are still in use
+      buffer = webrtc::I420Buffer::Create(width, height);
+    }
+    return buffer;
+  }
+  /// Fill a pooled video frame buffer with a video frame received from a
   /// fulfilled frame request.
   rtc::scoped_refptr<webrtc::VideoFrameBuffer> FillBuffer(const Argb32VideoFrame& frame_view) {
     // Check that the input frame fits within the constraints of chroma
     // downsampling (width and height multiple of 2).
     uint32_t width = frame_view.width_;
     uint32_t height = frame_view.height_;
-    // Create I420 buffer
-    rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create(width, height);
+    // Get I420 buffer
+    rtc::scoped_refptr<webrtc::I420Buffer> buffer = CreateI420Buffer(width, height);
     // Convert to I420 and copy to buffer
     libyuv::ARGBToI420(
       (const uint8_t*)frame_view.argb32_data_, frame_view.stride_,
@@ -164,6 +218,7 @@ class Argb32BufferAdapter {
   }
  private:
   std::shared_ptr<Argb32ExternalVideoSource> video_source_;
+  webrtc::VideoFrameBufferPool buffer_pool_;
 };
 
 /// Video track source acting as an adapter for an external source of raw
@@ -172,6 +227,12 @@ class ExternalVideoTrackSource : public RefCountedBase {
  public:
   using SourceState = webrtc::MediaSourceInterface::SourceState;
 
+  /// Interval between frame requests while the source is active.
+  static constexpr int64_t kFrameIntervalMs = 30;
+
+  /// Interval between frame requests while the source is idle.
+  static constexpr int64_t kIdleFrameIntervalMs = 100;
+
   /// Helper to create an external video track source from a custom ARGB32 video
   /// frame request callback.
   static RefPtr<ExternalVideoTrackSource> createFromArgb32(
@@ -194,12 +255,26 @@ class ExternalVideoTrackSource : public RefCountedBase {
                          int64_t timestamp_ms,
                          const Argb32VideoFrame& frame);
 
+  /// Complete a given video frame request with a frame already in I420 or
+  /// another WebRTC buffer format.
+  Result CompleteRequest(uint32_t request_id,
+                         int64_t timestamp_ms,
+                         rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer);
+
+  /// Get a recycled I420 buffer for a frame request. Capture thread only.
+  rtc::scoped_refptr<webrtc::I420Buffer> CreateI420Buffer(int width,
+                                                          int height);
+
   /// Stop the video capture. This will stop producing video frames.
   void StopCapture();
 
   /// Shutdown the source and release the buffer adapter and its callback.
   void Shutdown() noexcept;
 
+  /// Frames per second delivered to the video tracks, measured over about one
+  /// second.
+  float GetFrameRate() const { return frame_rate_.load(); }
+
   CustomTrackSourceAdapter* GetSourceImpl() const {
     return (CustomTrackSourceAdapter*)source_.get();
   }
@@ -210,6 +285,14 @@ class ExternalVideoTrackSource : public RefCountedBase {
 
   void OnMessage();
 
+  /// Remove the request and the older ones from the pending requests, and
+  /// return its timestamp, or -1 if it is not pending.
+  int64_t TakePendingRequest(uint32_t request_id);
+
+  /// Deliver a frame to all video tracks.
+  void DispatchBuffer(rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer,
+                      int64_t timestamp_ms);
+
   std::unique_ptr<Argb32BufferAdapter> adapter_;
   std::unique_ptr<rtc::Thread> capture_thread_;
   rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> source_;
@@ -223,6 +306,17 @@ class ExternalVideoTrackSource : public RefCountedBase {
 
   /// Lock for frame requests
   rtc::RecursiveCriticalSection request_lock_;
+
+  /// Frames delivered to the video tracks since the start
+  std::atomic<uint32_t> frames_dispatched_{};
+
+  /// Start of the current frame rate window and frames dispatched before it,
+  /// capture thread only
+  int64_t frame_rate_window_ms_{-1};
+  uint32_t frame_rate_window_frames_{};
+
+  /// Frame rate over the last complete window
+  std::atomic<float> frame_rate_{};
 };
 
 #endif //WEBRTC_WRAPPER_TRACK_SOURCE_H
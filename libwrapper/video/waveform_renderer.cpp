@@ -0,0 +1,183 @@
+#include "waveform_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+
+namespace {
+
+constexpr uint8_t kWhiteY = 235;
+constexpr uint8_t kBlackY = 16;
+constexpr uint8_t kNeutralUV = 128;
+
+struct Yuv {
+    int y;
+    // Offsets from kNeutralUV
+    int du;
+    int dv;
+};
+
+// Same integer formulas as libyuv for 8-bit RGB.
+Yuv RgbToYuv(int r, int g, int b) {
+    return {((66 * r + 129 * g + 25 * b + 128) >> 8) + 16,
+            (-38 * r - 74 * g + 112 * b + 128) >> 8,
+            (112 * r - 94 * g - 18 * b + 128) >> 8};
+}
+
+uint8_t ClampByte(int value) {
+    return (uint8_t)std::min(255, std::max(0, value));
+}
+
+void FillPlane(uint8_t *data, int stride, int width, int height, uint8_t value) {
+    for (int row = 0; row < height; row++) {
+        std::memset(data + row * stride, value, width);
+    }
+}
+
+int64_t Modulo(int64_t value, int64_t divisor) {
+    const int64_t result = value % divisor;
+    return result < 0 ? result + divisor : result;
+}
+
+} // namespace
+
+std::shared_ptr<const WaveformRenderer::ColorTable> WaveformRenderer::GetColorTable(int width, int height) {
+    static std::mutex lock;
+    static std::shared_ptr<const ColorTable> cached;
+    std::lock_guard<std::mutex> guard(lock);
+    if (cached && cached->width == width && cached->height == height) {
+        return cached;
+    }
+    auto table = std::make_shared<ColorTable>();
+    table->width = width;
+    table->height = height;
+    table->y.resize(width * height);
+    table->du.resize(width * height);
+    table->dv.resize(width * height);
+    for (int row = 0; row < height; row++) {
+        const float y = 1 - (row + 0.5f) * 2 / height;
+        for (int col = 0; col < width; col++) {
+            const float red = (col + 0.5f) / width;
+            const float alpha = red * (1 - std::fabs(y));
+            const Yuv yuv = RgbToYuv((int)(255 * (1 - alpha * (1 - red))),
+                                     (int)(255 * (1 - alpha * (0.5f - y / 2))),
+                                     255);
+            // Column by column, like the spans are drawn
+            const int i = col * height + row;
+            table->y[i] = ClampByte(yuv.y);
+            // A quarter of each pixel goes into the chroma of its 2x2 block
+            table->du[i] = (int8_t)(yuv.du / 4);
+            table->dv[i] = (int8_t)(yuv.dv / 4);
+        }
+    }
+    cached = table;
+    return cached;
+}
+
+void WaveformRenderer::Reset(int width, int height, size_t n_points) {
+    m_colors = GetColorTable(width, height);
+    m_n_points = n_points;
+    m_spans.assign(width, Span{0, -1});
+    m_end = INT64_MIN;
+}
+
+void WaveformRenderer::Render(const int16_t *points, size_t n_points, uint64_t total_points, float scale,
+                              const float *scores, const float *offsets, size_t n_scores,
+                              webrtc::I420Buffer *buffer) {
+    const int width = buffer->width();
+    const int height = buffer->height();
+    uint8_t *data_y = buffer->MutableDataY();
+    uint8_t *data_u = buffer->MutableDataU();
+    uint8_t *data_v = buffer->MutableDataV();
+    const int stride_y = buffer->StrideY();
+    const int stride_u = buffer->StrideU();
+    const int stride_v = buffer->StrideV();
+
+    if (!m_colors || m_colors->width != width || m_colors->height != height || m_n_points != n_points ||
+        m_scale != scale) {
+        Reset(width, height, n_points);
+        m_scale = scale;
+    }
+
+    const int64_t points_per_column = n_points / width;
+    if (points_per_column >= 2 && points_per_column % 2 == 0) {
+        // Column k runs from vertex k * vertices_per_column to the first one of
+        // the next column. Vertex j samples halfway between points 2j-1 and 2j,
+        // like the linear texture lookup did, so a column is complete once the
+        // first point of the next column arrived.
+        const int64_t vertices_per_column = points_per_column / 2;
+        const int64_t first_point = (int64_t)total_points - (int64_t)n_points;
+        const float inv_scale = 1.0f / scale;
+        auto point = [&](int64_t p) {
+            // Points before the stream started are silence
+            const int16_t value = p >= 0 && p >= first_point && p < (int64_t)total_points ? points[p % n_points] : 0;
+            return std::min(1.0f, std::max(-1.0f, value * inv_scale));
+        };
+        auto vertex = [&](int64_t j) {
+            return 0.5f * (point(2 * j - 1) + point(2 * j));
+        };
+
+        // The screen ends at an even column, so the 2x2 chroma blocks keep
+        // their columns while they scroll.
+        const int64_t complete = total_points > 0 ? ((int64_t)total_points - 1) / points_per_column : 0;
+        const int64_t end = complete & ~(int64_t)1;
+        int64_t begin = std::max(m_end, end - width);
+        if (m_end > end) {
+            // A new stream
+            begin = end - width;
+        }
+        for (int64_t k = begin; k < end; k++) {
+            float low = vertex(k * vertices_per_column);
+            float high = low;
+            for (int64_t j = k * vertices_per_column + 1; j <= (k + 1) * vertices_per_column; j++) {
+                const float value = vertex(j);
+                low = std::min(low, value);
+                high = std::max(high, value);
+            }
+            Span& span = m_spans[Modulo(k, width)];
+            span.top = (int16_t)std::max(0, std::min(height - 1, (int)((1 - high) / 2 * height)));
+            span.bottom = (int16_t)std::max(0, std::min(height - 1, (int)((1 - low) / 2 * height)));
+        }
+        m_end = end;
+    }
+
+    FillPlane(data_y, stride_y, width, height, kWhiteY);
+    FillPlane(data_u, stride_u, (width + 1) / 2, (height + 1) / 2, kNeutralUV);
+    FillPlane(data_v, stride_v, (width + 1) / 2, (height + 1) / 2, kNeutralUV);
+
+    // The line, screen column col shows absolute column m_end - width + col
+    const ColorTable& colors = *m_colors;
+    const int64_t origin = Modulo(m_end, width);
+    for (int col = 0; col < width; col++) {
+        const Span& span = m_spans[(origin + col) % width];
+        for (int row = span.top; row <= span.bottom; row++) {
+            const int i = col * height + row;
+            data_y[row * stride_y + col] = colors.y[i];
+            uint8_t &u = data_u[row / 2 * stride_u + col / 2];
+            uint8_t &v = data_v[row / 2 * stride_v + col / 2];
+            u = ClampByte(u + colors.du[i]);
+            v = ClampByte(v + colors.dv[i]);
+        }
+    }
+
+    // Score dots on top, they move every frame
+    const float half = n_scores / 2.0f;
+    for (size_t i = 0; i < n_scores; i++) {
+        if (!(scores[i] > 0.1f)) {
+            continue;
+        }
+        const float x = (i - half) / half + offsets[i] * 2;
+        const float y = scores[i];
+        const int left = (int)std::lround((x + 1) / 2 * width - 2.5f);
+        const int top = (int)std::lround((1 - y) / 2 * height - 2.5f);
+        for (int row = std::max(0, top); row < std::min(height, top + 5); row++) {
+            for (int col = std::max(0, left); col < std::min(width, left + 5); col++) {
+                data_y[row * stride_y + col] = kBlackY;
+                data_u[row / 2 * stride_u + col / 2] = kNeutralUV;
+                data_v[row / 2 * stride_v + col / 2] = kNeutralUV;
+            }
+        }
+    }
+}
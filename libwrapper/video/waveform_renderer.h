@@ -0,0 +1,66 @@
+#ifndef WEBRTC_WRAPPER_WAVEFORM_RENDERER_H
+#define WEBRTC_WRAPPER_WAVEFORM_RENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "api/video/i420_buffer.h"
+
+
+// Draws the picture of the OpenGL shaders (graph.v.glsl, graph2.v.glsl)
+// straight into the planes of an I420 buffer, without a GL context or a color
+// conversion:
+//  * a white background,
+//  * the waveform as a line through the averages of neighbour point pairs,
+//    colored by position and faded towards the left and the top and bottom,
+//  * a 5x5 black dot for every score above 0.1.
+// Colors use the BT.601 limited range coefficients of libyuv::ARGBToI420.
+//
+// The waveform scrolls: each frame rasterizes only the columns that became
+// complete since the previous one, older columns keep the rows they cover in
+// a ring. The color of a pixel depends on its place on the screen, so frames
+// are composed from the ring with a precomputed color table.
+class WaveformRenderer {
+public:
+    // points is a ring of the last n_points of the total_points samples of
+    // the stream, sample p at p % n_points. n_points is a multiple of twice
+    // the frame width, +-scale reaches the top and bottom. Score i is drawn at
+    // x = (i - n_scores / 2) / (n_scores / 2) + 2 * offsets[i] and
+    // y = scores[i], both in [-1, 1] from left and bottom.
+    void Render(const int16_t *points, size_t n_points, uint64_t total_points, float scale,
+                const float *scores, const float *offsets, size_t n_scores,
+                webrtc::I420Buffer *buffer);
+
+private:
+    // Luma and chroma share of every pixel of the line, blended over white.
+    struct ColorTable {
+        int width;
+        int height;
+        std::vector<uint8_t> y;
+        std::vector<int8_t> du;
+        std::vector<int8_t> dv;
+    };
+
+    // Rows covered by one column of the line.
+    struct Span {
+        int16_t top;
+        int16_t bottom;
+    };
+
+    // Shared by all renderers of the same size.
+    static std::shared_ptr<const ColorTable> GetColorTable(int width, int height);
+
+    void Reset(int width, int height, size_t n_points);
+
+    std::shared_ptr<const ColorTable> m_colors;
+    size_t m_n_points = 0;
+    float m_scale = 0;
+    // Absolute column k of the stream is at m_spans[k % width]
+    std::vector<Span> m_spans;
+    // Columns before this one are in m_spans
+    int64_t m_end = 0;
+};
+
+#endif //WEBRTC_WRAPPER_WAVEFORM_RENDERER_H
@@ -1,8 +1,13 @@
 #include "wrapper.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <rtc_base/thread.h>
 #include <rtc_base/ssl_adapter.h>
@@ -28,15 +33,26 @@
 #include "create_session_observer.h"
 #include "set_session_observer.h"
 
+#include "recognition_pool.h"
 #include "video/track_source.h"
 
 
+// Everything that belongs to a single remote peer. Sessions are keyed by the
+// opaque pointer the caller passes to CreateConnection.
+struct Connection {
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection;
+    std::unique_ptr<PeerConnectionObserver> connection_observer;
+    rtc::scoped_refptr<webrtc::CreateSessionDescriptionObserver> create_observer;
+    rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track;
+    RefPtr<ExternalVideoTrackSource> video_track_source;
+};
+
 rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> peer_connection_factory;
-rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection;
 
-std::unique_ptr<PeerConnectionObserver> ptr_connection_observer;
-rtc::scoped_refptr<webrtc::SetRemoteDescriptionObserverInterface> ptr_dummy_observer;
-rtc::scoped_refptr<webrtc::CreateSessionDescriptionObserver> ptr_create_observer;
+std::mutex connections_lock;
+std::map<void *, std::unique_ptr<Connection>> connections;
+
+std::unique_ptr<RecognitionPool> recognition_pool;
 
 std::thread webrtc_thread;
 rtc::Thread *webrtc_thread_wrapper;
@@ -44,9 +60,29 @@ std::unique_ptr<rtc::Thread> networkThread;
 std::unique_ptr<rtc::Thread> signalingThread;
 std::unique_ptr<rtc::Thread> workerThread;
 
-rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track;
-RefPtr<ExternalVideoTrackSource> video_track_source;
 
+static void DestroyConnection(std::unique_ptr<Connection> connection) {
+    if (!connection) {
+        return;
+    }
+    // Stop rendering first, the capture thread reads the audio sink state.
+    if (connection->video_track_source) {
+        connection->video_track_source->StopCapture();
+    }
+    // After Close() returns no observer callback is running or will run.
+    if (connection->peer_connection) {
+        connection->peer_connection->Close();
+    }
+    connection->create_observer = nullptr;
+    connection->peer_connection = nullptr;
+    connection->video_track = nullptr;
+    connection->connection_observer.reset();
+    if (connection->video_track_source) {
+        workerThread->BlockingCall([&] {
+            connection->video_track_source = nullptr;
+        });
+    }
+}
 
 void MainThreadEntry() {
 
@@ -118,37 +154,15 @@ void MainThreadEntry() {
         apm
     );
     
-    ptr_connection_observer = std::make_unique<PeerConnectionObserver>();
-
-    // Tracks need to be created from the worker thread
-    workerThread->BlockingCall([&] {
-        video_track_source = ExternalVideoTrackSource::createFromArgb32(ptr_connection_observer->m_audio_sink);
-    });
-
-    if (!video_track_source) {
-        RTC_LOG(LS_ERROR) << "Failed to create video_track_source";
-    }
-
-    video_track_source->FinishCreation();
-
-    // Create the video track
-    video_track = peer_connection_factory->CreateVideoTrack("video", video_track_source->GetSourceImpl());
-    if (!video_track) {
-        RTC_LOG(LS_ERROR) << "Failed to create local video track from source.";
-    }
-
-    if (!video_track->enabled()) {
-        RTC_LOG(LS_ERROR) << "video_track->enabled() - Failed";
-    }
-
     webrtc_thread_wrapper->Run();
 
-    if (peer_connection) {
-        peer_connection->Close();
-        peer_connection.release();
-        ptr_dummy_observer.release();
-        ptr_create_observer.release();
-        ptr_connection_observer.reset();
+    std::map<void *, std::unique_ptr<Connection>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        remaining.swap(connections);
+    }
+    for (auto&& it : remaining) {
+        DestroyConnection(std::move(it.second));
     }
 
     peer_connection_factory.release();
@@ -156,10 +170,7 @@ void MainThreadEntry() {
     audio_decoder_factory.release();
     audio_encoder_factory.release();
 
-    video_track_source->StopCapture();
-
     workerThread->BlockingCall([&] {
-        video_track_source.release();
         apm.release();
         adm.release();
         queueFactory.reset();
@@ -191,12 +202,14 @@ void MainThreadEntry() {
 }
 
 
-ConnectionWrapper::ConnectionWrapper() {
+ConnectionWrapper::ConnectionWrapper(size_t recognition_threads) {
 
     rtc::LogMessage::LogToDebug(rtc::LS_WARNING);
     rtc::LogMessage::LogTimestamps();
     rtc::LogMessage::LogThreads();
 
+    recognition_pool = std::make_unique<RecognitionPool>(recognition_threads);
+
     webrtc_thread = std::thread(MainThreadEntry);
 
     RTC_LOG(LS_INFO) << "WebRTC thread created";
@@ -208,14 +221,14 @@ void ConnectionWrapper::Join() {
 }
 
 void ConnectionWrapper::Quit() {
-    RTC_LOG(LS_WARNING) << "Quit Video thread";
-    video_track_source->StopCapture();
     RTC_LOG(LS_WARNING) << "Quit WebRTC thread";
     webrtc_thread_wrapper->Quit();
     webrtc_thread.join();
+    // All audio sinks are gone with their connections
+    recognition_pool.reset();
 }
 
-void ConnectionWrapper::CreateConnection(const char *sdp, callback_t send, callback2_t send2) {
+void ConnectionWrapper::CreateConnection(void *session, const char *sdp, callback_t send, callback2_t send2, const RecognitionOptions& options) {
 
     webrtc::PeerConnectionInterface::IceServer ice_server;
     ice_server.uri = "stun:stun.l.google.com:19302";
@@ -224,10 +237,31 @@ void ConnectionWrapper::CreateConnection(const char *sdp, callback_t send, callb
 	configuration.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
     configuration.servers.push_back(ice_server);
 
-    ptr_connection_observer->m_send = send;
-    ptr_connection_observer->m_send2 = send2;
+    auto connection = std::make_unique<Connection>();
+    connection->connection_observer = std::make_unique<PeerConnectionObserver>(session, send, send2, recognition_pool.get(), options);
 
-    webrtc::PeerConnectionDependencies dependencies(ptr_connection_observer.get());
+    // Headless sessions never start the capture thread or the OSMesa context
+    if (!options.headless) {
+        // Tracks need to be created from the worker thread
+        workerThread->BlockingCall([&] {
+            connection->video_track_source = ExternalVideoTrackSource::createFromArgb32(connection->connection_observer->m_audio_sink);
+        });
+
+        if (!connection->video_track_source) {
+            RTC_LOG(LS_ERROR) << "Failed to create video_track_source";
+            return;
+        }
+
+        connection->video_track_source->FinishCreation();
+
+        // Create the video track
+        connection->video_track = peer_connection_factory->CreateVideoTrack("video", connection->video_track_source->GetSourceImpl());
+        if (!connection->video_track) {
+            RTC_LOG(LS_ERROR) << "Failed to create local video track from source.";
+        }
+    }
+
+    webrtc::PeerConnectionDependencies dependencies(connection->connection_observer.get());
 
     auto peer_connection_result = peer_connection_factory->CreatePeerConnectionOrError(
         configuration,
@@ -235,9 +269,13 @@ void ConnectionWrapper::CreateConnection(const char *sdp, callback_t send, callb
     );
     if (!peer_connection_result.ok()) {
         RTC_LOG(LS_ERROR) << "CreatePeerConnectionOrError - Failed";
+        DestroyConnection(std::move(connection));
+        return;
     }
     RTC_LOG(LS_INFO) << "CreatePeerConnectionOrError - Ok";
-    peer_connection = peer_connection_result.MoveValue();
+    connection->peer_connection = peer_connection_result.MoveValue();
+
+    auto& peer_connection = connection->peer_connection;
 
     webrtc::DataChannelInit data_channel_config;
     data_channel_config.ordered = false;
@@ -255,34 +293,59 @@ void ConnectionWrapper::CreateConnection(const char *sdp, callback_t send, callb
         RTC_LOG(LS_ERROR) << "CreateSessionDescription - Failed: " << error.description.c_str();
     }
 
-    ptr_dummy_observer = new rtc::RefCountedObject<SetRemoteSessionDescObserver>();
+    rtc::scoped_refptr<webrtc::SetRemoteDescriptionObserverInterface> dummy_observer =
+        new rtc::RefCountedObject<SetRemoteSessionDescObserver>();
 
-    peer_connection->SetRemoteDescription(std::move(session_description), std::move(ptr_dummy_observer));
+    peer_connection->SetRemoteDescription(std::move(session_description), std::move(dummy_observer));
 
     auto rtp_transceivers = peer_connection->GetTransceivers();
     RTC_LOG(LS_INFO) << "RTP transceiver: " << rtp_transceivers.size();
     for (auto&& transceiver : rtp_transceivers) {
         std::string name = transceiver->mid().value_or("UNKNOWN");
         RTC_LOG(LS_INFO) << "RTP transceiver " << name.c_str();
-        if (name == "1") {
+        if (name == "1" && !connection->video_track) {
+            // A headless client offered video anyway, nothing is sent on it
+            if (!transceiver->SetDirectionWithError(webrtc::RtpTransceiverDirection::kInactive).ok()) {
+                RTC_LOG(LS_ERROR) << "SetDirectionWithError - Failed";
+            }
+        } else if (name == "1") {
             if (!transceiver->SetDirectionWithError(webrtc::RtpTransceiverDirection::kSendOnly).ok()) {
                 RTC_LOG(LS_ERROR) << "SetDirectionWithError - Failed";
             }
             rtc::scoped_refptr<webrtc::RtpSenderInterface> sender = transceiver->sender();
-            if (!sender->SetTrack(video_track.get())) {
+            if (!sender->SetTrack(connection->video_track.get())) {
                 RTC_LOG(LS_ERROR) << "SetTrack - Failed";
             }
             RTC_LOG(LS_INFO) << "SetTrack - Ok";
         }
     }
 
-    ptr_create_observer = new rtc::RefCountedObject<CreateSessionDescriptionObserver>(peer_connection, send);
+    connection->create_observer = new rtc::RefCountedObject<CreateSessionDescriptionObserver>(peer_connection, session, send);
 
     webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
-    peer_connection->CreateAnswer(ptr_create_observer.get(), options);
+    peer_connection->CreateAnswer(connection->create_observer.get(), options);
+
+    std::unique_ptr<Connection> replaced;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        replaced = std::move(connections[session]);
+        connections[session] = std::move(connection);
+    }
+    // A renegotiation from the same client replaces its previous connection.
+    DestroyConnection(std::move(replaced));
 }
 
-void ConnectionWrapper::AddCandidate(const char *sdp_mid, int sdp_mline_index, const char *candidate) {
+void ConnectionWrapper::AddCandidate(void *session, const char *sdp_mid, int sdp_mline_index, const char *candidate) {
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        auto it = connections.find(session);
+        if (it == connections.end()) {
+            RTC_LOG(LS_WARNING) << "AddCandidate: unknown session";
+            return;
+        }
+        peer_connection = it->second->peer_connection;
+    }
     webrtc::SdpParseError error;
     auto candidate_object = webrtc::CreateIceCandidate(
         std::string(sdp_mid),
@@ -292,3 +355,70 @@ void ConnectionWrapper::AddCandidate(const char *sdp_mid, int sdp_mline_index, c
     peer_connection->AddIceCandidate(candidate_object);
     RTC_LOG(LS_VERBOSE) << "IceCandidate added: " << std::string(sdp_mid) << ", " << sdp_mline_index << " = " << std::string(candidate);
 }
+
+void ConnectionWrapper::CloseConnection(void *session) {
+    std::unique_ptr<Connection> connection;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        auto it = connections.find(session);
+        if (it == connections.end()) {
+            return;
+        }
+        connection = std::move(it->second);
+        connections.erase(it);
+    }
+    RTC_LOG(LS_INFO) << "Close connection";
+    DestroyConnection(std::move(connection));
+}
+
+bool ConnectionWrapper::SendData(void *session, const char *payload) {
+    rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        auto it = connections.find(session);
+        if (it == connections.end() || !it->second->connection_observer) {
+            return false;
+        }
+        data_channel = it->second->connection_observer->GetDataChannel();
+    }
+    if (!data_channel || data_channel->state() != webrtc::DataChannelInterface::kOpen) {
+        return false;
+    }
+    // Send() hops to the signaling thread, so it runs without the lock.
+    std::string data(payload);
+    return data_channel->Send(webrtc::DataBuffer(data));
+}
+
+RecognitionStats ConnectionWrapper::GetRecognitionStats() {
+    RecognitionPool::Stats pool_stats = recognition_pool->GetStats();
+    RecognitionStats stats;
+    stats.threads = pool_stats.threads;
+    stats.queue_depth = pool_stats.queue_depth;
+    stats.tasks = pool_stats.tasks;
+    stats.avg_wait_ms = pool_stats.avg_wait_ms;
+    stats.max_wait_ms = pool_stats.max_wait_ms;
+    return stats;
+}
+
+size_t ConnectionWrapper::GetAudioFormatStats(void *session, AudioFormatStats *stats, size_t max_stats) {
+    std::vector<AudioFormatStats> formats;
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        auto it = connections.find(session);
+        if (it == connections.end() || !it->second->connection_observer) {
+            return 0;
+        }
+        formats = it->second->connection_observer->m_audio_sink->GetFormatStats();
+    }
+    std::copy_n(formats.begin(), std::min(formats.size(), max_stats), stats);
+    return formats.size();
+}
+
+float ConnectionWrapper::GetVideoFrameRate(void *session) {
+    std::lock_guard<std::mutex> lock(connections_lock);
+    auto it = connections.find(session);
+    if (it == connections.end() || !it->second->video_track_source) {
+        return 0;
+    }
+    return it->second->video_track_source->GetFrameRate();
+}
@@ -4,16 +4,73 @@
 #include <stddef.h>
 #include <stdint.h>
 
-using callback_t = void(*)(const char * payload);
-using callback2_t = void(*)(const int16_t* audio_data, size_t data_size, float *outputs);
+// Every callback receives the opaque session pointer passed to CreateConnection,
+// so one process can serve many peers at the same time.
+using callback_t = void(*)(void *session, const char * payload);
+// Receives only the 48kHz mono audio that arrived since the previous call, the
+// model keeps the context itself and resamples it. Writes at most max_outputs frame scores and returns how
+// many frames the new audio produced.
+using callback2_t = size_t(*)(void *session, const int16_t* audio_data, size_t data_size, float *outputs, size_t max_outputs);
+
+// Per session recognition settings, sample counts in 16kHz samples.
+struct RecognitionOptions {
+    // Audio passed to the recognizer at once, a multiple of 160 (10 msec) up
+    // to 16000 (1 sec). Short chunks lower the latency, long chunks batch more
+    // frames per model call.
+    size_t chunk_samples;
+    // Total stride of the model, samples behind each output frame.
+    size_t frame_samples;
+    // No video track: the session skips the OSMesa context, the capture
+    // thread and the video transceiver, and the caller sends the results with
+    // ConnectionWrapper::SendData instead.
+    bool headless;
+    // Draws the video frames straight into I420 buffers, scrolling the
+    // waveform and rasterizing only the new columns, instead of rendering
+    // every frame with OSMesa and converting it.
+    bool native_video;
+};
+
+struct RecognitionStats {
+    size_t threads;
+    // Audio chunks waiting for a recognition thread
+    size_t queue_depth;
+    uint64_t tasks;
+    // Time a chunk waits for a recognition thread
+    double avg_wait_ms;
+    double max_wait_ms;
+};
+
+// Audio a session received in one input format.
+struct AudioFormatStats {
+    int bits_per_sample;
+    // 0 for the formats seen after the first few, which share one entry
+    int sample_rate;
+    size_t channels;
+    uint64_t calls;
+    uint64_t frames;
+    // Calls in a format the session cannot convert
+    uint64_t dropped;
+};
 
 class ConnectionWrapper {
 public:
-    ConnectionWrapper();
+    // recognition_threads == 0 sizes the shared recognition pool by the number of cores
+    explicit ConnectionWrapper(size_t recognition_threads = 0);
     void Join();
     void Quit();
-    void CreateConnection(const char *sdp, callback_t send, callback2_t send2);
-    void AddCandidate(const char *sdp_mid, int sdp_mline_index, const char *candidate);
+    void CreateConnection(void *session, const char *sdp, callback_t send, callback2_t send2, const RecognitionOptions& options);
+    void AddCandidate(void *session, const char *sdp_mid, int sdp_mline_index, const char *candidate);
+    void CloseConnection(void *session);
+    // Sends a text message over the data channel the client opened, returns
+    // false if there is none yet.
+    bool SendData(void *session, const char *payload);
+    RecognitionStats GetRecognitionStats();
+    // Copies the counters of at most max_stats input formats of the session and
+    // returns the number of formats it has seen.
+    size_t GetAudioFormatStats(void *session, AudioFormatStats *stats, size_t max_stats);
+    // Video frames per second the session sends, lower during silence, 0 for
+    // headless sessions.
+    float GetVideoFrameRate(void *session);
 };
 
 #endif //WRAPPER_LIBRARY_H
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "inference/common/Functions.h"
+
+namespace {
+
+// Token set size and beam size of the served model.
+constexpr int kTokens = 9998;
+constexpr int kTopK = 3;
+
+std::vector<float> randomScores(int size) {
+  std::mt19937 gen(0);
+  std::normal_distribution<float> dist(0.0f, 4.0f);
+  std::vector<float> scores(size);
+  for (auto& score : scores) {
+    score = dist(gen);
+  }
+  return scores;
+}
+
+// The full softmax the decoder used before logSumExpTopK(): max, sum of exp,
+// then a partial sort of all the token indices.
+void softmaxTopK(
+    const std::vector<float>& input,
+    int k,
+    std::vector<size_t>& idx,
+    float* topValues,
+    int* topIndices) {
+  const size_t size = input.size();
+  float m = input[0];
+  for (size_t i = 1; i < size; ++i) {
+    m = std::max(m, input[i]);
+  }
+  float sum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    sum += std::exp(input[i] - m);
+  }
+  const float constant = m + std::log(sum);
+
+  idx.resize(size);
+  std::iota(idx.begin(), idx.end(), 0);
+  std::partial_sort(
+      idx.begin(), idx.begin() + k, idx.end(), [&](size_t a, size_t b) {
+        return input[a] > input[b];
+      });
+  for (int j = 0; j < k; ++j) {
+    topIndices[j] = idx[j];
+    topValues[j] = std::exp(input[idx[j]] - constant);
+  }
+}
+
+void BM_SoftmaxTopK(benchmark::State& state) {
+  const std::vector<float> scores = randomScores(kTokens);
+  std::vector<size_t> idx;
+  float topValues[kTopK];
+  int topIndices[kTopK];
+  for (auto _ : state) {
+    softmaxTopK(scores, kTopK, idx, topValues, topIndices);
+    benchmark::DoNotOptimize(topValues);
+    benchmark::DoNotOptimize(topIndices);
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens);
+}
+BENCHMARK(BM_SoftmaxTopK);
+
+void BM_LogSumExpTopK(benchmark::State& state) {
+  const std::vector<float> scores = randomScores(kTokens);
+  float topValues[kTopK];
+  int topIndices[kTopK];
+  for (auto _ : state) {
+    const float logSumExp = w2l::streaming::logSumExpTopK(
+        scores.data(), kTokens, kTopK, topValues, topIndices);
+    for (int j = 0; j < kTopK; ++j) {
+      topValues[j] = std::exp(topValues[j] - logSumExp);
+    }
+    benchmark::DoNotOptimize(topValues);
+    benchmark::DoNotOptimize(topIndices);
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens);
+}
+BENCHMARK(BM_LogSumExpTopK);
+
+// The code the element-wise kernels replaced, as it was in meanAndStddev(),
+// meanNormalize(), LocalNorm, Relu and Residual.
+
+void meanAndStddevReference(
+    const float* in,
+    int size,
+    float& mean,
+    float& stddev) {
+  float sum = std::accumulate(in, in + size, 0.0);
+  mean = sum / size;
+  float sqSum = std::inner_product(in, in + size, in, 0.0);
+  stddev = std::sqrt(sqSum / size - mean * mean);
+}
+
+void meanNormalizeReference(
+    const float* in,
+    int size,
+    float mean,
+    float stddev,
+    float weight,
+    float bias,
+    float* output) {
+  std::transform(in, in + size, output, [mean, stddev, weight, bias](float x) {
+    return bias + weight * ((x - mean) / stddev);
+  });
+}
+
+void reluReference(float* inputPtr, int size) {
+  for (int i = 0; i < size; ++i) {
+    inputPtr[i] = std::fmax(inputPtr[i], 0.0);
+  }
+}
+
+void addInPlaceReference(const float* aPtr, int len, float* bPtr) {
+  for (int i = 0; i < len; ++i) {
+    bPtr[i] += aPtr[i];
+  }
+}
+
+void BM_SumAndSquaredSumReference(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  const float* inPtr = in.data();
+  const int featureSize = in.size();
+  for (auto _ : state) {
+    float curSum = std::accumulate(inPtr, inPtr + featureSize, 0.0);
+    float curSqSum = std::inner_product(inPtr, inPtr + featureSize, inPtr, 0.0);
+    benchmark::DoNotOptimize(curSum);
+    benchmark::DoNotOptimize(curSqSum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SumAndSquaredSumReference)->Range(1 << 10, 1 << 16);
+
+void BM_SumAndSquaredSum(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  for (auto _ : state) {
+    double sum;
+    double squaredSum;
+    w2l::streaming::sumAndSquaredSum(in.data(), in.size(), sum, squaredSum);
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(squaredSum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SumAndSquaredSum)->Range(1 << 10, 1 << 16);
+
+void BM_MeanAndStddevReference(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  for (auto _ : state) {
+    float mean;
+    float stddev;
+    meanAndStddevReference(in.data(), in.size(), mean, stddev);
+    benchmark::DoNotOptimize(mean);
+    benchmark::DoNotOptimize(stddev);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MeanAndStddevReference)->Range(1 << 10, 1 << 16);
+
+void BM_MeanAndStddev(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  for (auto _ : state) {
+    float mean;
+    float stddev;
+    w2l::streaming::meanAndStddev(in.data(), in.size(), mean, stddev);
+    benchmark::DoNotOptimize(mean);
+    benchmark::DoNotOptimize(stddev);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MeanAndStddev)->Range(1 << 10, 1 << 16);
+
+void BM_MeanNormalizeReference(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> out(in.size());
+  for (auto _ : state) {
+    meanNormalizeReference(
+        in.data(), in.size(), 0.1f, 4.0f, 2.0f, 0.5f, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MeanNormalizeReference)->Range(1 << 10, 1 << 16);
+
+void BM_MeanNormalize(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> out(in.size());
+  for (auto _ : state) {
+    w2l::streaming::meanNormalize(
+        in.data(), in.size(), 0.1f, 4.0f, 2.0f, 0.5f, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MeanNormalize)->Range(1 << 10, 1 << 16);
+
+void BM_ReluReference(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> data(in.size());
+  for (auto _ : state) {
+    std::copy(in.begin(), in.end(), data.begin());
+    reluReference(data.data(), data.size());
+    benchmark::DoNotOptimize(data.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReluReference)->Range(1 << 10, 1 << 16);
+
+void BM_Relu(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> data(in.size());
+  for (auto _ : state) {
+    std::copy(in.begin(), in.end(), data.begin());
+    w2l::streaming::relu(data.data(), data.size());
+    benchmark::DoNotOptimize(data.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Relu)->Range(1 << 10, 1 << 16);
+
+void BM_AddInPlaceReference(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> out(in.size());
+  for (auto _ : state) {
+    addInPlaceReference(in.data(), in.size(), out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddInPlaceReference)->Range(1 << 10, 1 << 16);
+
+void BM_AddInPlace(benchmark::State& state) {
+  const std::vector<float> in = randomScores(state.range(0));
+  std::vector<float> out(in.size());
+  for (auto _ : state) {
+    w2l::streaming::addInPlace(in.data(), in.size(), out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddInPlace)->Range(1 << 10, 1 << 16);
+
+} // namespace
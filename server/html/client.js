@@ -2,8 +2,21 @@ let webSocketConnection = null;
 let rtcPeerConnection = null;
 let dataChannel = null;
 
+// Audio passed to the recognizer at once, a multiple of 10 msec. Can be set
+// with the "chunk" query parameter, e.g. ?chunk=1000 for bulk transcription.
+const chunkMs = parseInt(new URLSearchParams(window.location.search).get("chunk") || "10");
+// Without video the server renders nothing and sends the recognized words over
+// the data channel, e.g. ?headless=1 for API and bulk callers.
+const headless = new URLSearchParams(window.location.search).get("headless") === "1";
+// "gl" renders the frames with OpenGL on the server, e.g. ?renderer=gl
+const renderer = new URLSearchParams(window.location.search).get("renderer") || "native";
+
 function onDataChannelMessage(event) {
   console.log(event.data);
+  const message = JSON.parse(event.data);
+  if (message.type === "words") {
+    document.getElementById("words").textContent = message.words.join(" ");
+  }
 }
 
 function onDataChannelOpen() {
@@ -21,7 +34,7 @@ function handleNegotiationNeededEvent() {
   rtcPeerConnection.createOffer(sdpConstraints)
     .then((offer) => rtcPeerConnection.setLocalDescription(offer))
     .then(() => {
-      webSocketConnection.send(JSON.stringify({type: "offer", payload: rtcPeerConnection.localDescription}));
+      webSocketConnection.send(JSON.stringify({type: "offer", payload: rtcPeerConnection.localDescription, options: {chunkMs: chunkMs, headless: headless, renderer: renderer}}));
     })
     .catch(reportError);
 }
@@ -33,7 +46,7 @@ function handleTrackEvent(event) {
 
 function handleConnectionStateChange(event) {
   button = document.getElementById("button");
-  video = document.getElementById("video");
+  video = document.getElementById(headless ? "words" : "video");
   if (rtcPeerConnection.connectionState == "disconnected") {
     button.style.display = "block";
     video.style.display = "none";
@@ -46,7 +59,7 @@ function handleConnectionStateChange(event) {
 
 function onWebSocketClose() {
   button = document.getElementById("button");
-  video = document.getElementById("video");
+  video = document.getElementById(headless ? "words" : "video");
   button.style.display = "block";
   video.style.display = "none";
   button.disabled = false;
@@ -65,6 +78,9 @@ function onWebSocketOpen() {
     console.log("addTransceiver: audio");
     const taudio = rtcPeerConnection.addTransceiver(stream.getAudioTracks()[0], {streams: [stream]});
     console.log(taudio);
+    if (headless) {
+      return;
+    }
     console.log("addTransceiver: video");
     const tvideo = rtcPeerConnection.addTransceiver("video", {direction: "recvonly", streams: [stream]});
     console.log(tvideo);
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/common/ArenaMemoryManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace w2l {
+namespace streaming {
+
+namespace {
+
+constexpr size_t kAlignment = 64;
+
+size_t alignUp(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+struct Block {
+  char* data;
+  size_t size;
+};
+
+// Per thread state of one ArenaMemoryManager.
+struct Arena {
+  std::vector<Block> blocks;
+  // Offset of the next allocation in the last block.
+  size_t offset = 0;
+  // Bytes handed out since the last reset, over all blocks.
+  size_t runBytes = 0;
+  int depth = 0;
+  int live = 0;
+
+  ~Arena() {
+    for (auto& block : blocks) {
+      std::free(block.data);
+    }
+  }
+};
+
+Arena& threadArena(const ArenaMemoryManager* manager) {
+  thread_local std::unordered_map<const ArenaMemoryManager*, Arena> arenas;
+  return arenas[manager];
+}
+
+char* allocateBlock(size_t size) {
+  void* data = std::aligned_alloc(kAlignment, size);
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(data);
+}
+
+} // namespace
+
+ArenaMemoryManager::ArenaMemoryManager(size_t initialBlockSize)
+    : initialBlockSize_(alignUp(initialBlockSize)),
+      nAllocations_(0),
+      nHeapAllocations_(0),
+      nResets_(0),
+      maxRunBytes_(0) {}
+
+void* ArenaMemoryManager::allocate(size_t sizeInBytes) {
+  Arena& arena = threadArena(this);
+  const size_t size = alignUp(sizeInBytes == 0 ? 1 : sizeInBytes);
+  if (arena.blocks.empty() ||
+      arena.offset + size > arena.blocks.back().size) {
+    const size_t blockSize = std::max(size, initialBlockSize_);
+    arena.blocks.push_back({allocateBlock(blockSize), blockSize});
+    arena.offset = 0;
+    nHeapAllocations_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = arena.blocks.back().data + arena.offset;
+  arena.offset += size;
+  arena.runBytes += size;
+  ++arena.live;
+  nAllocations_.fetch_add(1, std::memory_order_relaxed);
+  return ptr;
+}
+
+void ArenaMemoryManager::free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  Arena& arena = threadArena(this);
+  assert(arena.live > 0);
+  // Outside of a RunScope the arena is rewound as soon as it is empty.
+  if (--arena.live == 0 && arena.depth == 0) {
+    rewind(&arena);
+  }
+}
+
+void ArenaMemoryManager::beginRun() {
+  ++threadArena(this).depth;
+}
+
+void ArenaMemoryManager::endRun() {
+  Arena& arena = threadArena(this);
+  assert(arena.depth > 0);
+  if (--arena.depth == 0 && arena.live == 0) {
+    rewind(&arena);
+  }
+}
+
+void ArenaMemoryManager::rewind(void* arenaPtr) {
+  Arena& arena = *static_cast<Arena*>(arenaPtr);
+  uint64_t maxRunBytes = maxRunBytes_.load(std::memory_order_relaxed);
+  while (arena.runBytes > maxRunBytes &&
+         !maxRunBytes_.compare_exchange_weak(maxRunBytes, arena.runBytes)) {
+  }
+  // Replace a chain of blocks by one that fits the whole run.
+  if (arena.blocks.size() > 1) {
+    size_t total = 0;
+    for (auto& block : arena.blocks) {
+      total += block.size;
+      std::free(block.data);
+    }
+    arena.blocks.clear();
+    arena.blocks.push_back({allocateBlock(total), total});
+    nHeapAllocations_.fetch_add(1, std::memory_order_relaxed);
+  }
+  arena.offset = 0;
+  arena.runBytes = 0;
+  nResets_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string ArenaMemoryManager::debugString() const {
+  std::stringstream ss;
+  ss << "ArenaMemoryManager:{initialBlockSize=" << initialBlockSize_
+     << " allocations=" << nAllocations_.load()
+     << " heapAllocations=" << nHeapAllocations_.load()
+     << " resets=" << nResets_.load()
+     << " maxRunBytes=" << maxRunBytes_.load() << "}";
+  return ss.str();
+}
+
+} // namespace streaming
+} // namespace w2l
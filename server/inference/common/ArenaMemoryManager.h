@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "inference/common/MemoryManager.h"
+
+namespace w2l {
+namespace streaming {
+
+// Bump allocator for temporary workspaces. Every thread allocates from its own
+// arena; free() only counts, and the arena is rewound when the outermost
+// RunScope of the thread ends. Memory allocated during a run must be freed
+// before that. An arena that overflowed during a run is replaced by a single
+// block large enough for the whole run, so after the first passes the
+// inference loop does not touch the heap.
+class ArenaMemoryManager : public MemoryManager {
+ public:
+  explicit ArenaMemoryManager(size_t initialBlockSize = 1 << 20);
+
+  virtual ~ArenaMemoryManager() override = default;
+
+  void beginRun() override;
+  void endRun() override;
+
+  std::string debugString() const override;
+
+ protected:
+  void* allocate(size_t sizeInBytes) override;
+  void free(void* ptr) override;
+
+ private:
+  // Returns the arena of the calling thread to its start.
+  void rewind(void* arena);
+
+  const size_t initialBlockSize_;
+
+  // Stats
+  std::atomic<uint64_t> nAllocations_;
+  std::atomic<uint64_t> nHeapAllocations_;
+  std::atomic<uint64_t> nResets_;
+  std::atomic<uint64_t> maxRunBytes_;
+};
+
+} // namespace streaming
+} // namespace w2l
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/common/Decimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "inference/common/Functions.h"
+
+namespace w2l {
+namespace streaming {
+
+namespace {
+
+// Scales int16 samples to [-1, 1).
+constexpr const float kMaxInt16 = static_cast<float>(0x8000);
+
+// Number of windows of nTaps samples starting at begin, begin + factor, ...
+// that fit into length samples.
+int countWindows(int begin, int length, int nTaps, int factor) {
+  if (begin + nTaps > length) {
+    return 0;
+  }
+  return (length - nTaps - begin) / factor + 1;
+}
+
+} // namespace
+
+Decimator::Decimator(int factor, int tapsPerPhase)
+    : factor_(factor), start_(0) {
+  if (factor < 1 || tapsPerPhase < 1) {
+    std::stringstream ss;
+    ss << "Invalid argument at Decimator::Decimator(factor=" << factor
+       << " tapsPerPhase=" << tapsPerPhase << ")";
+    throw std::invalid_argument(ss.str());
+  }
+  const int nTaps = factor * tapsPerPhase + 1;
+  const double center = (nTaps - 1) / 2.0;
+  const double cutoff = 0.9 * 0.5 / factor;
+  std::vector<double> taps(nTaps);
+  double sum = 0.0;
+  for (int n = 0; n < nTaps; ++n) {
+    const double x = 2.0 * M_PI * cutoff * (n - center);
+    const double sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+    const double phase = 2.0 * M_PI * n / (nTaps - 1);
+    const double window =
+        0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+    taps[n] = sinc * window;
+    sum += taps[n];
+  }
+  // Unit gain at DC, with the int16 scaling folded in.
+  taps_.resize(nTaps);
+  for (int n = 0; n < nTaps; ++n) {
+    taps_[n] = taps[n] / (sum * kMaxInt16);
+  }
+  history_.resize(2 * (nTaps - 1));
+  reset();
+}
+
+int Decimator::outputSize(int size) const {
+  const int historySize = nTaps() - 1;
+  return countWindows(start_, historySize + size, nTaps(), factor_);
+}
+
+int Decimator::process(const int16_t* in, int size, float* out) {
+  const int historySize = nTaps() - 1;
+  const int bridged = std::min(size, historySize);
+  std::copy_n(in, bridged, history_.begin() + historySize);
+
+  // Windows that start in the history.
+  int written = 0;
+  if (start_ < historySize) {
+    const int n = std::min(
+        countWindows(start_, historySize + bridged, nTaps(), factor_),
+        (historySize - start_ + factor_ - 1) / factor_);
+    decimate(
+        history_.data() + start_, n, factor_, taps_.data(), nTaps(), out);
+    start_ += n * factor_;
+    written += n;
+  }
+  // The rest is read in place.
+  if (start_ >= historySize) {
+    const int begin = start_ - historySize;
+    const int n = countWindows(begin, size, nTaps(), factor_);
+    decimate(
+        in + begin, n, factor_, taps_.data(), nTaps(), out + written);
+    start_ += n * factor_;
+    written += n;
+  }
+
+  if (size >= historySize) {
+    std::copy_n(in + size - historySize, historySize, history_.begin());
+  } else {
+    std::copy_n(history_.begin() + size, historySize, history_.begin());
+  }
+  start_ -= size;
+  return written;
+}
+
+void Decimator::reset() {
+  std::fill(history_.begin(), history_.end(), 0);
+  start_ = 0;
+}
+
+std::string Decimator::debugString() const {
+  std::stringstream ss;
+  ss << "Decimator:{factor=" << factor_ << " nTaps=" << nTaps()
+     << " start=" << start_ << "}";
+  return ss.str();
+}
+
+} // namespace streaming
+} // namespace w2l
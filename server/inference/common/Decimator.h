@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace w2l {
+namespace streaming {
+
+// Streaming integer ratio downsampler from int16 PCM to float in [-1, 1).
+// Conversion, anti-aliasing low pass and decimation are one FIR pass that
+// computes only the kept samples, so a caller can write straight into the
+// input IOBuffer of the feature module:
+//
+//   Decimator decimator(3); // 48kHz -> 16kHz
+//   buffer->ensure<float>(decimator.outputSize(size));
+//   buffer->move<float>(decimator.process(in, size, buffer->tail<float>()));
+//
+// Keeps the last nTaps() - 1 input samples of a stream between calls.
+class Decimator {
+ public:
+  // Blackman windowed sinc of factor * tapsPerPhase + 1 taps, with the
+  // cutoff at 90% of the output Nyquist frequency.
+  explicit Decimator(int factor, int tapsPerPhase = 32);
+
+  // Number of samples process() writes for size more input samples.
+  int outputSize(int size) const;
+
+  // Writes outputSize(size) samples to out and returns their number.
+  int process(const int16_t* in, int size, float* out);
+
+  // Starts a new stream.
+  void reset();
+
+  int factor() const {
+    return factor_;
+  }
+
+  int nTaps() const {
+    return taps_.size();
+  }
+
+  std::string debugString() const;
+
+ private:
+  const int factor_;
+  std::vector<float> taps_;
+  // The last nTaps() - 1 input samples, followed by room for as many new
+  // samples, so windows across the call boundary are contiguous too.
+  std::vector<int16_t> history_;
+  // Start of the next window, counted from the first sample of history_.
+  int start_;
+};
+
+} // namespace streaming
+} // namespace w2l
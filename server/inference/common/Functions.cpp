@@ -5,18 +5,530 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "inference/common/Functions.h"
+
 #include <algorithm>
+#include <cassert>
 #include <cmath>
-#include <numeric>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define W2L_STREAMING_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define W2L_STREAMING_NEON 1
+#endif
 
 namespace w2l {
 namespace streaming {
 
+namespace {
+
+// Inserts value into the descending top-k list. The caller has checked that it
+// is larger than the current k-th value, so earlier indices win ties.
+inline void
+insertTopK(float value, int index, int k, float* topValues, int* topIndices) {
+  int pos = k - 1;
+  while (pos > 0 && topValues[pos - 1] < value) {
+    topValues[pos] = topValues[pos - 1];
+    topIndices[pos] = topIndices[pos - 1];
+    --pos;
+  }
+  topValues[pos] = value;
+  topIndices[pos] = index;
+}
+
+void topKScalar(
+    const float* in,
+    int begin,
+    int size,
+    int k,
+    float* topValues,
+    int* topIndices) {
+  for (int i = begin; i < size; ++i) {
+    if (in[i] > topValues[k - 1]) {
+      insertTopK(in[i], i, k, topValues, topIndices);
+    }
+  }
+}
+
+float sumExpScalar(const float* in, int begin, int size, float max) {
+  float sum = 0.0;
+  for (int i = begin; i < size; ++i) {
+    sum += std::exp(in[i] - max);
+  }
+  return sum;
+}
+
+#ifdef W2L_STREAMING_X86
+
+// Cephes expf: exp(x) = 2^n * exp(r), |r| <= ln(2)/2, with a degree 5
+// polynomial for exp(r). Relative error is below 2e-7 in the clamped range.
+constexpr float kExpMin = -87.3f;
+constexpr float kExpMax = 88.3f;
+constexpr float kLog2e = 1.44269504088896341f;
+constexpr float kLn2Hi = 0.693359375f;
+constexpr float kLn2Lo = -2.12194440e-4f;
+constexpr float kExpP0 = 1.9875691500e-4f;
+constexpr float kExpP1 = 1.3981999507e-3f;
+constexpr float kExpP2 = 8.3334519073e-3f;
+constexpr float kExpP3 = 4.1665795894e-2f;
+constexpr float kExpP4 = 1.6666665459e-1f;
+constexpr float kExpP5 = 5.0000001201e-1f;
+
+__attribute__((target("avx2,fma"))) inline __m256 expAvx2(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(kExpMin)),
+                    _mm256_set1_ps(kExpMax));
+  __m256 n = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Lo), r);
+  __m256 p = _mm256_set1_ps(kExpP0);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP1));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP2));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP3));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP4));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP5));
+  p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+  p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+  __m256i e = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx2,fma"))) void topKAvx2(
+    const float* in,
+    int size,
+    int k,
+    float* topValues,
+    int* topIndices) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x = _mm256_loadu_ps(in + i);
+    __m256 threshold = _mm256_set1_ps(topValues[k - 1]);
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(x, threshold, _CMP_GT_OQ));
+    while (mask) {
+      int lane = __builtin_ctz(mask);
+      mask &= mask - 1;
+      if (in[i + lane] > topValues[k - 1]) {
+        insertTopK(in[i + lane], i + lane, k, topValues, topIndices);
+      }
+    }
+  }
+  topKScalar(in, i, size, k, topValues, topIndices);
+}
+
+__attribute__((target("avx2,fma"))) float
+sumExpAvx2(const float* in, int size, float max) {
+  __m256 vmax = _mm256_set1_ps(max);
+  __m256 acc = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x = _mm256_sub_ps(_mm256_loadu_ps(in + i), vmax);
+    acc = _mm256_add_ps(acc, expAvx2(x));
+  }
+  __m128 sum4 = _mm_add_ps(
+      _mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  sum4 = _mm_add_ss(sum4, _mm_movehdup_ps(sum4));
+  return _mm_cvtss_f32(sum4) + sumExpScalar(in, i, size, max);
+}
+
+// GCC 12 warns about the _mm512_undefined_*() sources inside the unmasked
+// AVX-512 intrinsics (GCC bug 105593, fixed in 12.3 and 13), so the warnings
+// are off around the AVX-512 kernels.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f"))) inline __m512 expAvx512(__m512 x) {
+  x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(kExpMin)),
+                    _mm512_set1_ps(kExpMax));
+  __m512 n = _mm512_roundscale_ps(
+      _mm512_mul_ps(x, _mm512_set1_ps(kLog2e)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Hi), x);
+  r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Lo), r);
+  __m512 p = _mm512_set1_ps(kExpP0);
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(kExpP1));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(kExpP2));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(kExpP3));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(kExpP4));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(kExpP5));
+  p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), r);
+  p = _mm512_add_ps(p, _mm512_set1_ps(1.0f));
+  return _mm512_scalef_ps(p, n);
+}
+
+__attribute__((target("avx512f"))) void topKAvx512(
+    const float* in,
+    int size,
+    int k,
+    float* topValues,
+    int* topIndices) {
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512 x = _mm512_loadu_ps(in + i);
+    __m512 threshold = _mm512_set1_ps(topValues[k - 1]);
+    unsigned mask = _mm512_cmp_ps_mask(x, threshold, _CMP_GT_OQ);
+    while (mask) {
+      int lane = __builtin_ctz(mask);
+      mask &= mask - 1;
+      if (in[i + lane] > topValues[k - 1]) {
+        insertTopK(in[i + lane], i + lane, k, topValues, topIndices);
+      }
+    }
+  }
+  topKScalar(in, i, size, k, topValues, topIndices);
+}
+
+__attribute__((target("avx512f"))) float
+sumExpAvx512(const float* in, int size, float max) {
+  __m512 vmax = _mm512_set1_ps(max);
+  __m512 acc = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512 x = _mm512_sub_ps(_mm512_loadu_ps(in + i), vmax);
+    acc = _mm512_add_ps(acc, expAvx512(x));
+  }
+  return _mm512_reduce_add_ps(acc) + sumExpScalar(in, i, size, max);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // W2L_STREAMING_X86
+
+// Element-wise and reduction kernels. Each returns the number of leading
+// elements it processed, the caller finishes the rest with the scalar code.
+// Sums are accumulated in double like the scalar code.
+
+#ifdef W2L_STREAMING_X86
+
+__attribute__((target("avx2,fma"))) inline double hsumAvx2(__m256d x) {
+  __m128d sum =
+      _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+__attribute__((target("avx2,fma"))) int sumAndSquaredSumAvx2(
+    const float* in,
+    int size,
+    double& sum,
+    double& squaredSum) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  __m256d sq0 = _mm256_setzero_pd();
+  __m256d sq1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x = _mm256_loadu_ps(in + i);
+    __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+    __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+    sum0 = _mm256_add_pd(sum0, lo);
+    sum1 = _mm256_add_pd(sum1, hi);
+    sq0 = _mm256_fmadd_pd(lo, lo, sq0);
+    sq1 = _mm256_fmadd_pd(hi, hi, sq1);
+  }
+  sum = hsumAvx2(_mm256_add_pd(sum0, sum1));
+  squaredSum = hsumAvx2(_mm256_add_pd(sq0, sq1));
+  return i;
+}
+
+__attribute__((target("avx2"))) int meanNormalizeAvx2(
+    const float* in,
+    int size,
+    float mean,
+    float stddev,
+    float weight,
+    float bias,
+    float* output) {
+  const __m256 vmean = _mm256_set1_ps(mean);
+  const __m256 vstddev = _mm256_set1_ps(stddev);
+  const __m256 vweight = _mm256_set1_ps(weight);
+  const __m256 vbias = _mm256_set1_ps(bias);
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x = _mm256_sub_ps(_mm256_loadu_ps(in + i), vmean);
+    x = _mm256_mul_ps(vweight, _mm256_div_ps(x, vstddev));
+    _mm256_storeu_ps(output + i, _mm256_add_ps(vbias, x));
+  }
+  return i;
+}
+
+// max_ps returns its second operand for NaN, so NaN becomes 0 like fmax().
+__attribute__((target("avx2"))) int reluAvx2(float* data, int size) {
+  const __m256 zero = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(data + i, _mm256_max_ps(_mm256_loadu_ps(data + i), zero));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) int
+addInPlaceAvx2(const float* in, int size, float* out) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(
+        out + i,
+        _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_loadu_ps(in + i)));
+  }
+  return i;
+}
+
+// Returns the number of taps summed into dot.
+__attribute__((target("avx2,fma"))) int
+dotInt16Avx2(const int16_t* in, const float* taps, int nTaps, float& dot) {
+  __m256 acc = _mm256_setzero_ps();
+  int k = 0;
+  for (; k + 8 <= nTaps; k += 8) {
+    __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + k))));
+    acc = _mm256_fmadd_ps(x, _mm256_loadu_ps(taps + k), acc);
+  }
+  __m128 sum4 = _mm_add_ps(
+      _mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  sum4 = _mm_add_ss(sum4, _mm_movehdup_ps(sum4));
+  dot = _mm_cvtss_f32(sum4);
+  return k;
+}
+
+// GCC bug 105593, see expAvx512().
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f"))) int sumAndSquaredSumAvx512(
+    const float* in,
+    int size,
+    double& sum,
+    double& squaredSum) {
+  __m512d sum0 = _mm512_setzero_pd();
+  __m512d sum1 = _mm512_setzero_pd();
+  __m512d sq0 = _mm512_setzero_pd();
+  __m512d sq1 = _mm512_setzero_pd();
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512d lo = _mm512_cvtps_pd(_mm256_loadu_ps(in + i));
+    __m512d hi = _mm512_cvtps_pd(_mm256_loadu_ps(in + i + 8));
+    sum0 = _mm512_add_pd(sum0, lo);
+    sum1 = _mm512_add_pd(sum1, hi);
+    sq0 = _mm512_fmadd_pd(lo, lo, sq0);
+    sq1 = _mm512_fmadd_pd(hi, hi, sq1);
+  }
+  sum = _mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1));
+  squaredSum = _mm512_reduce_add_pd(_mm512_add_pd(sq0, sq1));
+  return i;
+}
+
+__attribute__((target("avx512f"))) int meanNormalizeAvx512(
+    const float* in,
+    int size,
+    float mean,
+    float stddev,
+    float weight,
+    float bias,
+    float* output) {
+  const __m512 vmean = _mm512_set1_ps(mean);
+  const __m512 vstddev = _mm512_set1_ps(stddev);
+  const __m512 vweight = _mm512_set1_ps(weight);
+  const __m512 vbias = _mm512_set1_ps(bias);
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512 x = _mm512_sub_ps(_mm512_loadu_ps(in + i), vmean);
+    // The explicit rounding keeps the compiler from contracting the multiply
+    // and add into an FMA, so results match the scalar code.
+    x = _mm512_mul_round_ps(
+        vweight,
+        _mm512_div_ps(x, vstddev),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm512_storeu_ps(output + i, _mm512_add_ps(vbias, x));
+  }
+  return i;
+}
+
+__attribute__((target("avx512f"))) int reluAvx512(float* data, int size) {
+  const __m512 zero = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(data + i, _mm512_max_ps(_mm512_loadu_ps(data + i), zero));
+  }
+  return i;
+}
+
+__attribute__((target("avx512f"))) int
+addInPlaceAvx512(const float* in, int size, float* out) {
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(
+        out + i,
+        _mm512_add_ps(_mm512_loadu_ps(out + i), _mm512_loadu_ps(in + i)));
+  }
+  return i;
+}
+
+__attribute__((target("avx512f"))) int
+dotInt16Avx512(const int16_t* in, const float* taps, int nTaps, float& dot) {
+  __m512 acc = _mm512_setzero_ps();
+  int k = 0;
+  for (; k + 16 <= nTaps; k += 16) {
+    __m512 x = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + k))));
+    acc = _mm512_fmadd_ps(x, _mm512_loadu_ps(taps + k), acc);
+  }
+  dot = _mm512_reduce_add_ps(acc);
+  return k;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // W2L_STREAMING_X86
+
+#ifdef W2L_STREAMING_NEON
+
+int sumAndSquaredSumNeon(
+    const float* in,
+    int size,
+    double& sum,
+    double& squaredSum) {
+  float64x2_t sum0 = vdupq_n_f64(0.0);
+  float64x2_t sum1 = vdupq_n_f64(0.0);
+  float64x2_t sq0 = vdupq_n_f64(0.0);
+  float64x2_t sq1 = vdupq_n_f64(0.0);
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    float32x4_t x = vld1q_f32(in + i);
+    float64x2_t lo = vcvt_f64_f32(vget_low_f32(x));
+    float64x2_t hi = vcvt_high_f64_f32(x);
+    sum0 = vaddq_f64(sum0, lo);
+    sum1 = vaddq_f64(sum1, hi);
+    sq0 = vfmaq_f64(sq0, lo, lo);
+    sq1 = vfmaq_f64(sq1, hi, hi);
+  }
+  sum = vaddvq_f64(vaddq_f64(sum0, sum1));
+  squaredSum = vaddvq_f64(vaddq_f64(sq0, sq1));
+  return i;
+}
+
+int meanNormalizeNeon(
+    const float* in,
+    int size,
+    float mean,
+    float stddev,
+    float weight,
+    float bias,
+    float* output) {
+  const float32x4_t vmean = vdupq_n_f32(mean);
+  const float32x4_t vstddev = vdupq_n_f32(stddev);
+  const float32x4_t vweight = vdupq_n_f32(weight);
+  const float32x4_t vbias = vdupq_n_f32(bias);
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    float32x4_t x = vdivq_f32(vsubq_f32(vld1q_f32(in + i), vmean), vstddev);
+    vst1q_f32(output + i, vaddq_f32(vbias, vmulq_f32(vweight, x)));
+  }
+  return i;
+}
+
+// vmaxnm returns the number when the other operand is NaN, like fmax().
+int reluNeon(float* data, int size) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(data + i, vmaxnmq_f32(vld1q_f32(data + i), zero));
+  }
+  return i;
+}
+
+int addInPlaceNeon(const float* in, int size, float* out) {
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vld1q_f32(in + i)));
+  }
+  return i;
+}
+
+int dotInt16Neon(const int16_t* in, const float* taps, int nTaps, float& dot) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  int k = 0;
+  for (; k + 8 <= nTaps; k += 8) {
+    int16x8_t x = vld1q_s16(in + k);
+    acc0 = vfmaq_f32(
+        acc0, vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), vld1q_f32(taps + k));
+    acc1 = vfmaq_f32(
+        acc1, vcvtq_f32_s32(vmovl_high_s16(x)), vld1q_f32(taps + k + 4));
+  }
+  dot = vaddvq_f32(vaddq_f32(acc0, acc1));
+  return k;
+}
+
+#endif // W2L_STREAMING_NEON
+
+#ifdef W2L_STREAMING_X86
+
+enum class SimdLevel { kScalar, kAvx2, kAvx512 };
+
+SimdLevel detectSimdLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdLevel::kAvx512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SimdLevel::kAvx2;
+  }
+  return SimdLevel::kScalar;
+}
+
+SimdLevel simdLevel() {
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+#endif // W2L_STREAMING_X86
+
+} // namespace
+
+void sumAndSquaredSum(
+    const float* in,
+    int size,
+    double& sum,
+    double& squaredSum) {
+  int i = 0;
+  sum = 0.0;
+  squaredSum = 0.0;
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+  if (level == SimdLevel::kAvx512) {
+    i = sumAndSquaredSumAvx512(in, size, sum, squaredSum);
+  } else if (level == SimdLevel::kAvx2) {
+    i = sumAndSquaredSumAvx2(in, size, sum, squaredSum);
+  }
+#elif defined(W2L_STREAMING_NEON)
+  i = sumAndSquaredSumNeon(in, size, sum, squaredSum);
+#endif
+  for (; i < size; ++i) {
+    sum += in[i];
+    squaredSum += static_cast<double>(in[i]) * in[i];
+  }
+}
+
 void meanAndStddev(const float* in, int size, float& mean, float& stddev) {
-  float sum = std::accumulate(in, in + size, 0.0);
-  mean = sum / size;
-  float sqSum = std::inner_product(in, in + size, in, 0.0);
-  stddev = std::sqrt(sqSum / size - mean * mean);
+  double sum, squaredSum;
+  sumAndSquaredSum(in, size, sum, squaredSum);
+  mean = static_cast<float>(sum) / size;
+  stddev = std::sqrt(static_cast<float>(squaredSum) / size - mean * mean);
 }
 
 void meanNormalize(
@@ -27,9 +539,128 @@ void meanNormalize(
     float weight,
     float bias,
     float* output) {
-  std::transform(in, in + size, output, [mean, stddev, weight, bias](float x) {
-    return bias + weight * ((x - mean) / stddev);
-  });
+  int i = 0;
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+  if (level == SimdLevel::kAvx512) {
+    i = meanNormalizeAvx512(in, size, mean, stddev, weight, bias, output);
+  } else if (level == SimdLevel::kAvx2) {
+    i = meanNormalizeAvx2(in, size, mean, stddev, weight, bias, output);
+  }
+#elif defined(W2L_STREAMING_NEON)
+  i = meanNormalizeNeon(in, size, mean, stddev, weight, bias, output);
+#endif
+  for (; i < size; ++i) {
+    output[i] = bias + weight * ((in[i] - mean) / stddev);
+  }
+}
+
+void relu(float* data, int size) {
+  int i = 0;
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+  if (level == SimdLevel::kAvx512) {
+    i = reluAvx512(data, size);
+  } else if (level == SimdLevel::kAvx2) {
+    i = reluAvx2(data, size);
+  }
+#elif defined(W2L_STREAMING_NEON)
+  i = reluNeon(data, size);
+#endif
+  for (; i < size; ++i) {
+    data[i] = std::fmax(data[i], 0.0f);
+  }
+}
+
+void addInPlace(const float* in, int size, float* out) {
+  int i = 0;
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+  if (level == SimdLevel::kAvx512) {
+    i = addInPlaceAvx512(in, size, out);
+  } else if (level == SimdLevel::kAvx2) {
+    i = addInPlaceAvx2(in, size, out);
+  }
+#elif defined(W2L_STREAMING_NEON)
+  i = addInPlaceNeon(in, size, out);
+#endif
+  for (; i < size; ++i) {
+    out[i] += in[i];
+  }
+}
+
+void decimate(
+    const int16_t* in,
+    int nOutputs,
+    int factor,
+    const float* taps,
+    int nTaps,
+    float* out) {
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+#endif
+  for (int i = 0; i < nOutputs; ++i) {
+    const int16_t* window = in + i * factor;
+    float dot = 0.0;
+    int k = 0;
+#ifdef W2L_STREAMING_X86
+    if (level == SimdLevel::kAvx512) {
+      k = dotInt16Avx512(window, taps, nTaps, dot);
+    } else if (level == SimdLevel::kAvx2) {
+      k = dotInt16Avx2(window, taps, nTaps, dot);
+    }
+#elif defined(W2L_STREAMING_NEON)
+    k = dotInt16Neon(window, taps, nTaps, dot);
+#endif
+    for (; k < nTaps; ++k) {
+      dot += taps[k] * window[k];
+    }
+    out[i] = dot;
+  }
+}
+
+float logSumExpTopK(
+    const float* in,
+    int size,
+    int k,
+    float* topValues,
+    int* topIndices) {
+  assert(k >= 1 && k <= kMaxTopK && k <= size);
+  std::fill(topValues, topValues + k, -std::numeric_limits<float>::infinity());
+  std::fill(topIndices, topIndices + k, -1);
+
+  // The top-1 score is the maximum, so a single pass finds both.
+#ifdef W2L_STREAMING_X86
+  const SimdLevel level = simdLevel();
+  if (level == SimdLevel::kAvx512) {
+    topKAvx512(in, size, k, topValues, topIndices);
+  } else if (level == SimdLevel::kAvx2) {
+    topKAvx2(in, size, k, topValues, topIndices);
+  } else {
+    topKScalar(in, 0, size, k, topValues, topIndices);
+  }
+#else
+  topKScalar(in, 0, size, k, topValues, topIndices);
+#endif
+
+  const float max = topValues[0];
+  if (!std::isfinite(max)) {
+    return max;
+  }
+
+  float sum;
+#ifdef W2L_STREAMING_X86
+  if (level == SimdLevel::kAvx512) {
+    sum = sumExpAvx512(in, size, max);
+  } else if (level == SimdLevel::kAvx2) {
+    sum = sumExpAvx2(in, size, max);
+  } else {
+    sum = sumExpScalar(in, 0, size, max);
+  }
+#else
+  sum = sumExpScalar(in, 0, size, max);
+#endif
+  return max + std::log(sum);
 }
 
 } // namespace streaming
@@ -7,9 +7,20 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace w2l {
 namespace streaming {
 
+// The kernels below use AVX-512, AVX2 or NEON when the CPU supports it.
+
+// Sum and sum of squares of in, accumulated in double.
+void sumAndSquaredSum(
+    const float* in,
+    int size,
+    double& sum,
+    double& squaredSum);
+
 void meanAndStddev(const float* in, int size, float& mean, float& stddev);
 
 // out = bias + weight * (in - mean) / stddev
@@ -22,5 +33,37 @@ void meanNormalize(
     float bias,
     float* output);
 
+// data = max(data, 0), NaN becomes 0.
+void relu(float* data, int size);
+
+// out += in
+void addInPlace(const float* in, int size, float* out);
+
+// FIR filter keeping every factor-th output, with int16 input:
+//   out[i] = sum(taps[k] * in[i * factor + k] for k < nTaps), i < nOutputs
+// in holds (nOutputs - 1) * factor + nTaps samples.
+void decimate(
+    const int16_t* in,
+    int nOutputs,
+    int factor,
+    const float* taps,
+    int nTaps,
+    float* out);
+
+// Largest k supported by logSumExpTopK().
+constexpr int kMaxTopK = 16;
+
+// Fused max, log-sum-exp and top-k over the scores of one output frame.
+// Writes the k largest scores and their indices in descending order into
+// topValues and topIndices, and returns log(sum(exp(in))), so that the
+// probability of a score is exp(score - logSumExp). Uses AVX-512 or AVX2 when
+// the CPU supports it and never allocates. 1 <= k <= min(size, kMaxTopK).
+float logSumExpTopK(
+    const float* in,
+    int size,
+    int k,
+    float* topValues,
+    int* topIndices);
+
 } // namespace streaming
 } // namespace w2l
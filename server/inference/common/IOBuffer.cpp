@@ -7,52 +7,288 @@
 
 #include "inference/common/IOBuffer.h"
 
-#include <math.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
 #include <cstring>
+#include <new>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 namespace w2l {
 namespace streaming {
 
-IOBuffer::IOBuffer(int initialSize, const std::string& name)
-    : buf_(initialSize), offsetInBytes_(0), sizeInBytes_(0), name_(name) {}
+namespace {
 
-IOBuffer::IOBuffer(const void* buffer, int sizeInBytes, const std::string& name)
-    : buf_(
-          static_cast<const char*>(buffer),
-          static_cast<const char*>(buffer) + sizeInBytes),
+// Largest capacity that still fits the uint32_t offsets and int sizes.
+constexpr uint64_t kMaxCapacity = 1u << 30;
+
+uint64_t nextPowerOfTwo(uint64_t value) {
+  uint64_t result = kIOBufferAlignment;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+uint64_t alignUp(uint64_t value) {
+  return (value + kIOBufferAlignment - 1) & ~uint64_t(kIOBufferAlignment - 1);
+}
+
+uint64_t pageSize() {
+  static const uint64_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+char* allocateLinear(uint64_t capacity) {
+  void* data = std::aligned_alloc(kIOBufferAlignment, capacity);
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(data);
+}
+
+// Maps a memory file of capacity bytes twice back to back. Returns nullptr if
+// that fails.
+char* allocateRing(uint64_t capacity) {
+  int fd = memfd_create("w2l-iobuffer", MFD_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  char* base = nullptr;
+  if (ftruncate(fd, capacity) == 0) {
+    void* reserved = mmap(
+        nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved != MAP_FAILED) {
+      base = static_cast<char*>(reserved);
+      for (int i = 0; i < 2 && base; ++i) {
+        void* half = mmap(
+            base + i * capacity,
+            capacity,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED,
+            fd,
+            0);
+        if (half == MAP_FAILED) {
+          munmap(base, 2 * capacity);
+          base = nullptr;
+        }
+      }
+    }
+  }
+  close(fd);
+  return base;
+}
+
+} // namespace
+
+IOBuffer::IOBuffer(int initialSize, const std::string& name)
+    : buf_(nullptr),
+      capacityInBytes_(0),
+      ring_(false),
       offsetInBytes_(0),
-      sizeInBytes_(sizeInBytes),
+      sizeInBytes_(0),
       name_(name) {
+  if (initialSize < 0) {
+    std::stringstream ss;
+    ss << "Invalid initialSize at IOBuffer::IOBuffer(initialSize="
+       << initialSize << " name=" << name << ")";
+    throw std::invalid_argument(ss.str());
+  }
+  if (initialSize > 0) {
+    reallocate(nextPowerOfTwo(initialSize), false);
+  }
+}
+
+IOBuffer::IOBuffer(const void* buffer, int sizeInBytes, const std::string& name)
+    : IOBuffer(0, name) {
   if (sizeInBytes < 0) {
     std::stringstream ss;
     ss << "Invalid index at IOBuffer::IOBuffer(buffer=" << buffer
        << " sizeInBytes=" << sizeInBytes << " name=" << name << ")";
     throw std::invalid_argument(ss.str());
   }
+  if (sizeInBytes > 0) {
+    reallocate(nextPowerOfTwo(sizeInBytes), false);
+    std::memcpy(buf_, buffer, sizeInBytes);
+    sizeInBytes_ = sizeInBytes;
+  }
 }
 
-int IOBuffer::headRoom() const {
-  if (offsetInBytes_ < 0) {
-    throw std::runtime_error(
-        "Invalid offsetInBytes_=" + std::to_string(offsetInBytes_) +
-        " in IOBuffer::headRoom()");
+IOBuffer::IOBuffer(const IOBuffer& other)
+    : IOBuffer(other.data<void>(), other.sizeInBytes_, other.name_) {}
+
+IOBuffer& IOBuffer::operator=(const IOBuffer& other) {
+  if (this != &other) {
+    IOBuffer copy(other);
+    *this = std::move(copy);
   }
+  return *this;
+}
+
+IOBuffer::IOBuffer(IOBuffer&& other) noexcept
+    : buf_(other.buf_),
+      capacityInBytes_(other.capacityInBytes_),
+      ring_(other.ring_),
+      offsetInBytes_(other.offsetInBytes_),
+      sizeInBytes_(other.sizeInBytes_),
+      name_(std::move(other.name_)) {
+  other.buf_ = nullptr;
+  other.capacityInBytes_ = 0;
+  other.ring_ = false;
+  other.offsetInBytes_ = 0;
+  other.sizeInBytes_ = 0;
+}
+
+IOBuffer& IOBuffer::operator=(IOBuffer&& other) noexcept {
+  if (this != &other) {
+    release();
+    buf_ = other.buf_;
+    capacityInBytes_ = other.capacityInBytes_;
+    ring_ = other.ring_;
+    offsetInBytes_ = other.offsetInBytes_;
+    sizeInBytes_ = other.sizeInBytes_;
+    name_ = std::move(other.name_);
+    other.buf_ = nullptr;
+    other.capacityInBytes_ = 0;
+    other.ring_ = false;
+    other.offsetInBytes_ = 0;
+    other.sizeInBytes_ = 0;
+  }
+  return *this;
+}
+
+IOBuffer::~IOBuffer() {
+  release();
+}
+
+void IOBuffer::release() {
+  if (ring_) {
+    munmap(buf_, 2 * static_cast<size_t>(capacityInBytes_));
+  } else {
+    std::free(buf_);
+  }
+  buf_ = nullptr;
+  capacityInBytes_ = 0;
+  ring_ = false;
+}
+
+int IOBuffer::headRoom() const {
   return offsetInBytes_;
 }
 
 int IOBuffer::tailRoom() const {
-  return buf_.size() - headRoom() - sizeInBytes_;
+  if (ring_) {
+    // The second mapping extends the storage past its end.
+    return capacityInBytes_ - sizeInBytes_;
+  }
+  return capacityInBytes_ - headRoom() - sizeInBytes_;
 }
 
 void IOBuffer::reset() {
-  if (buf_.data()) {
-    std::memmove(buf_.data(), data<void>(), sizeInBytes_);
+  if (buf_ && offsetInBytes_ > 0) {
+    std::memmove(buf_, data<void>(), sizeInBytes_);
   }
   offsetInBytes_ = 0;
 }
 
+void IOBuffer::ensureBytes(int bytes) {
+  if (!ring_ && headRoom() + tailRoom() >= bytes) {
+    reset();
+  } else {
+    reserveBytes(static_cast<uint64_t>(sizeInBytes_) + bytes);
+  }
+}
+
+int IOBuffer::prependRoom() const {
+  return ring_ ? capacityInBytes_ - sizeInBytes_ : offsetInBytes_;
+}
+
+void IOBuffer::swapStorage(IOBuffer& other) noexcept {
+  std::swap(buf_, other.buf_);
+  std::swap(capacityInBytes_, other.capacityInBytes_);
+  std::swap(ring_, other.ring_);
+  std::swap(offsetInBytes_, other.offsetInBytes_);
+  std::swap(sizeInBytes_, other.sizeInBytes_);
+}
+
+void IOBuffer::spliceBytes(IOBuffer& other, int bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  if (static_cast<uint32_t>(bytes) == other.sizeInBytes_ &&
+      (sizeInBytes_ == 0 ||
+       (sizeInBytes_ <= other.sizeInBytes_ &&
+        static_cast<uint32_t>(other.prependRoom()) >= sizeInBytes_))) {
+    if (sizeInBytes_ > 0) {
+      other.offsetInBytes_ = other.ring_
+          ? (other.offsetInBytes_ + other.capacityInBytes_ - sizeInBytes_) %
+              other.capacityInBytes_
+          : other.offsetInBytes_ - sizeInBytes_;
+      other.sizeInBytes_ += sizeInBytes_;
+      std::memcpy(other.data<void>(), data<void>(), sizeInBytes_);
+    }
+    swapStorage(other);
+    other.clear();
+    return;
+  }
+  ensure<char>(bytes);
+  std::memcpy(tail<void>(), other.data<void>(), bytes);
+  sizeInBytes_ += bytes;
+  other.consume<char>(bytes);
+}
+
+void IOBuffer::reserveBytes(uint64_t bytes) {
+  if (bytes <= capacityInBytes_) {
+    return;
+  }
+  reallocate(nextPowerOfTwo(bytes), ring_);
+}
+
+bool IOBuffer::enableRing() {
+  if (!ring_) {
+    reallocate(capacityInBytes_, true);
+  }
+  return ring_;
+}
+
+void IOBuffer::reallocate(uint64_t capacityInBytes, bool ring) {
+  uint64_t capacity = std::max<uint64_t>(capacityInBytes, sizeInBytes_);
+  if (capacity > kMaxCapacity) {
+    std::stringstream ss;
+    ss << "IOBuffer::reallocate(capacityInBytes=" << capacityInBytes
+       << ") exceeds maximum capacity=" << kMaxCapacity << " "
+       << debugString();
+    throw std::length_error(ss.str());
+  }
+  char* storage = nullptr;
+  if (ring) {
+    // Both the mappings and the wrap around need page sized storage.
+    const uint64_t ringCapacity = std::max(nextPowerOfTwo(capacity), pageSize());
+    storage = allocateRing(ringCapacity);
+    if (storage) {
+      capacity = ringCapacity;
+    } else {
+      // Out of memory files or mappings, linear storage still works.
+      ring = false;
+    }
+  }
+  if (!storage && capacity > 0) {
+    capacity = alignUp(capacity);
+    storage = allocateLinear(capacity);
+  }
+  if (sizeInBytes_ > 0) {
+    std::memcpy(storage, data<void>(), sizeInBytes_);
+  }
+  release();
+  buf_ = storage;
+  capacityInBytes_ = capacity;
+  ring_ = ring;
+  offsetInBytes_ = 0;
+}
+
 std::string IOBuffer::debugString() const {
   return debugStringHelper();
 }
@@ -62,7 +298,8 @@ std::string IOBuffer::debugStringHelper(const std::string& content) const {
   ss << "IOBuffer:{"
         "name_="
      << name_ << " offsetInBytes_=" << offsetInBytes_
-     << " buf_.size()=" << buf_.size() << " sizeInBytes_=" << sizeInBytes_;
+     << " capacityInBytes_=" << capacityInBytes_ << " ring_=" << ring_
+     << " sizeInBytes_=" << sizeInBytes_;
   if (!content.empty()) {
     ss << " content:" << content;
   }
@@ -73,11 +310,6 @@ std::string IOBuffer::debugStringHelper(const std::string& content) const {
 void IOBuffer::clear() {
   offsetInBytes_ = 0;
   sizeInBytes_ = 0;
-  buf_.clear();
-}
-
-std::vector<char>& IOBuffer::buffer() {
-  return buf_;
 }
 
 } // namespace streaming
@@ -9,23 +9,42 @@
 
 #include <cereal/access.hpp>
 #include <cereal/archives/xml.hpp>
-#include <cereal/types/vector.hpp>
+#include <cereal/cereal.hpp>
 #include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
 #include <string>
-#include <vector>
 
 namespace w2l {
 namespace streaming {
 
+constexpr int kIOBufferAlignment = 64;
+
 // Inspired by folly::IOBuffer
-// Currently memory is unalinged, will make it aligned if it improves
-// performance.
+// Storage is uninitialized and 64-byte aligned, and data() stays aligned as
+// long as the buffer is consumed in multiples of 64 bytes. Capacity grows in
+// powers of two.
+//
+// In ring mode the storage is a memory file mapped twice back to back, so the
+// live data is always contiguous and consume() / ensure() never move it. A
+// linear buffer moves its data to the front when it runs out of tail room. A
+// ring that cannot be mapped when it grows continues as a linear buffer.
 class IOBuffer {
  public:
   explicit IOBuffer(int initialSize = 0, const std::string& name = "");
 
   IOBuffer(const void* buffer, int sizeInBytes, const std::string& name = "");
 
+  // Copies are linear and hold only the live data.
+  IOBuffer(const IOBuffer& other);
+  IOBuffer& operator=(const IOBuffer& other);
+  IOBuffer(IOBuffer&& other) noexcept;
+  IOBuffer& operator=(IOBuffer&& other) noexcept;
+
+  ~IOBuffer();
+
   template <typename T>
   T* data();
 
@@ -46,16 +65,40 @@ class IOBuffer {
   template <typename T>
   void ensure(int size);
 
+  // Allocates room for at least size elements in total, so that a stream with
+  // known chunk sizes does not grow the buffer while running.
+  template <typename T>
+  void reserve(int size);
+
+  // Switches to ring mode keeping the content. Returns false, leaving the
+  // buffer linear, if the platform cannot map memory twice.
+  bool enableRing();
+
+  bool isRing() const {
+    return ring_;
+  }
+
+  int capacityInBytes() const {
+    return capacityInBytes_;
+  }
+
   template <typename T>
   void write(const T* buf, int size);
 
   template <typename T>
   void writeZero(int size);
 
+  // Appends the first size elements of other and consumes them from other.
+  // When all of other is taken the storage of both buffers is exchanged, and
+  // the data of this buffer, if any, is copied in front of other's, so only
+  // the smaller side is copied.
+  template <typename T>
+  void splice(IOBuffer& other, int size);
+
   template <typename T>
   void move(int size);
 
-  // Marks buffer as empty.
+  // Marks buffer as empty. Keeps the allocated storage.
   void clear();
 
   template <typename T>
@@ -66,24 +109,62 @@ class IOBuffer {
   template <typename T>
   std::string debugStringWithContent() const;
 
-  std::vector<char>& buffer();
-
  private:
   int headRoom() const;
   int tailRoom() const;
   void reset();
+  void ensureBytes(int bytes);
+  void spliceBytes(IOBuffer& other, int bytes);
+  // Bytes that can be put in front of data() without moving it.
+  int prependRoom() const;
+  void swapStorage(IOBuffer& other) noexcept;
+  void reserveBytes(uint64_t bytes);
+  // Replaces the storage by one of capacityInBytes, copying the live data to
+  // its front.
+  void reallocate(uint64_t capacityInBytes, bool ring);
+  void release();
   std::string debugStringHelper(const std::string& content = "") const;
 
-  std::vector<char> buf_;
+  char* buf_;
+  uint32_t capacityInBytes_;
+  bool ring_;
   uint32_t offsetInBytes_; // value in bytes
   uint32_t sizeInBytes_; // value in bytes. This is the write head location.
   std::string name_;
 
   friend class cereal::access;
 
+  // Same format as the former std::vector<char> storage, but only the live
+  // data is written.
   template <class Archive>
-  void serialize(Archive& ar) {
-    ar(buf_, offsetInBytes_, sizeInBytes_, name_);
+  void save(Archive& ar) const {
+    const uint32_t offsetInBytes = 0;
+    ar(cereal::make_size_tag(static_cast<uint64_t>(sizeInBytes_)));
+    ar(cereal::binary_data(data<char>(), sizeInBytes_));
+    ar(offsetInBytes, sizeInBytes_, name_);
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    uint64_t storedSize = 0;
+    ar(cereal::make_size_tag(storedSize));
+    if (storedSize > INT32_MAX) {
+      throw std::runtime_error(
+          "IOBuffer::load() invalid size=" + std::to_string(storedSize));
+    }
+    release();
+    sizeInBytes_ = 0;
+    offsetInBytes_ = 0;
+    reallocate(storedSize, false);
+    ar(cereal::binary_data(buf_, storedSize));
+    ar(offsetInBytes_, sizeInBytes_, name_);
+    if (offsetInBytes_ > storedSize ||
+        sizeInBytes_ > storedSize - offsetInBytes_) {
+      std::stringstream ss;
+      ss << "IOBuffer::load() invalid offsetInBytes_=" << offsetInBytes_
+         << " sizeInBytes_=" << sizeInBytes_ << " stored size=" << storedSize;
+      throw std::runtime_error(ss.str());
+    }
   }
 };
 
@@ -117,22 +198,22 @@ T IOBufferAddress(const char* buf, int offsetInBytes, int indexInBytes = 0) {
 
 template <typename T>
 T* IOBuffer::data() {
-  return IOBufferAddress<T*>(buf_.data(), offsetInBytes_);
+  return IOBufferAddress<T*>(buf_, offsetInBytes_);
 }
 
 template <typename T>
 const T* IOBuffer::data() const {
-  return IOBufferAddress<const T*>(buf_.data(), offsetInBytes_);
+  return IOBufferAddress<const T*>(buf_, offsetInBytes_);
 }
 
 template <typename T>
 T* IOBuffer::tail() {
-  return IOBufferAddress<T*>(buf_.data(), offsetInBytes_, sizeInBytes_);
+  return IOBufferAddress<T*>(buf_, offsetInBytes_, sizeInBytes_);
 }
 
 template <typename T>
 const T* IOBuffer::tail() const {
-  return IOBufferAddress<const T*>(buf_.data(), offsetInBytes_, sizeInBytes_);
+  return IOBufferAddress<const T*>(buf_, offsetInBytes_, sizeInBytes_);
 }
 
 template <typename T>
@@ -143,7 +224,7 @@ void IOBuffer::consume(int size) {
     throw std::invalid_argument(ss.str());
   }
   const int bytes = size * sizeof(T);
-  if (bytes > sizeInBytes_) {
+  if (static_cast<uint32_t>(bytes) > sizeInBytes_) {
     std::stringstream ss;
     ss << "Request to IOBuffer::consume[](size=" << size
        << " sizeof(T)=" << sizeof(T)
@@ -153,6 +234,12 @@ void IOBuffer::consume(int size) {
   }
   offsetInBytes_ += bytes;
   sizeInBytes_ -= bytes;
+  if (sizeInBytes_ == 0) {
+    // Free realignment of the next write.
+    offsetInBytes_ = 0;
+  } else if (ring_ && offsetInBytes_ >= capacityInBytes_) {
+    offsetInBytes_ -= capacityInBytes_;
+  }
 }
 
 template <typename T>
@@ -164,18 +251,19 @@ void IOBuffer::ensure(int size) {
   }
 
   const int bytes = size * sizeof(T);
+  if (tailRoom() < bytes) {
+    ensureBytes(bytes);
+  }
+}
 
-  if (tailRoom() >= bytes) {
-    return;
-  } else if (headRoom() + tailRoom() >= bytes) {
-    reset();
-  } else {
-    reset();
-    // increment similar to std::vector
-    int finalSize = bytes + buf_.size();
-    finalSize = pow(2, ceil(log(finalSize) / log(2)));
-    buf_.resize(finalSize);
+template <typename T>
+void IOBuffer::reserve(int size) {
+  if (size < 0) {
+    std::stringstream ss;
+    ss << "Invalid size at IOBuffer::reserve[](size=" << size << ")";
+    throw std::invalid_argument(ss.str());
   }
+  reserveBytes(size * sizeof(T));
 }
 
 template <typename T>
@@ -185,10 +273,11 @@ void IOBuffer::move(int size) {
     ss << "Invalid size at IOBuffer::move[](size=" << size << ")=";
     throw std::invalid_argument(ss.str());
   }
-  if (sizeInBytes_ + size * sizeof(T) > buf_.size()) {
+  if (size * sizeof(T) > static_cast<size_t>(tailRoom())) {
     std::stringstream ss;
     ss << "Cannot move beyond end of buffer IOBuffer::move[](size=" << size
-       << "): sizeInBytes_=" << sizeInBytes_ << " buf_.size()=" << buf_.size();
+       << "): sizeInBytes_=" << sizeInBytes_
+       << " capacityInBytes_=" << capacityInBytes_;
     throw std::invalid_argument(ss.str());
   }
   sizeInBytes_ += (size * sizeof(T));
@@ -206,6 +295,17 @@ void IOBuffer::write(const T* buf, int size) {
   move<T>(size);
 }
 
+template <typename T>
+void IOBuffer::splice(IOBuffer& other, int size) {
+  if (size < 0 || size > other.size<T>()) {
+    std::stringstream ss;
+    ss << "Invalid size at IOBuffer::splice[](size=" << size
+       << ") other=" << other.debugString();
+    throw std::invalid_argument(ss.str());
+  }
+  spliceBytes(other, size * sizeof(T));
+}
+
 template <typename T>
 void IOBuffer::writeZero(int size) {
   ensure<T>(size);
@@ -215,7 +315,6 @@ void IOBuffer::writeZero(int size) {
 
 template <typename T>
 int IOBuffer::size() const {
-  assert(sizeInBytes_ >= 0);
   return sizeInBytes_ / sizeof(T);
 }
 
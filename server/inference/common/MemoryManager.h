@@ -9,6 +9,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 namespace w2l {
 namespace streaming {
@@ -18,6 +19,47 @@ namespace streaming {
 // device.
 class MemoryManager {
  public:
+  // Frees memory through the manager that allocated it.
+  class Deleter {
+   public:
+    explicit Deleter(MemoryManager* memoryManager = nullptr)
+        : memoryManager_(memoryManager) {}
+
+    void operator()(void* ptr) const {
+      memoryManager_->free(ptr);
+    }
+
+   private:
+    MemoryManager* memoryManager_;
+  };
+
+  template <typename T>
+  using UniquePtr = std::unique_ptr<T[], Deleter>;
+
+  // Marks a pass over the inference graph on the calling thread. Scopes nest,
+  // managers may recycle all memory of the thread when the outermost ends.
+  class RunScope {
+   public:
+    explicit RunScope(MemoryManager* memoryManager)
+        : memoryManager_(memoryManager) {
+      if (memoryManager_) {
+        memoryManager_->beginRun();
+      }
+    }
+
+    ~RunScope() {
+      if (memoryManager_) {
+        memoryManager_->endRun();
+      }
+    }
+
+    RunScope(const RunScope&) = delete;
+    RunScope& operator=(const RunScope&) = delete;
+
+   private:
+    MemoryManager* memoryManager_;
+  };
+
   MemoryManager() {}
 
   virtual ~MemoryManager() = default;
@@ -30,6 +72,15 @@ class MemoryManager {
     return std::shared_ptr<T>((T*)allocate(size * sizeof(T)), deleter);
   }
 
+  // Same as makeShared() without the allocation of a shared_ptr control block.
+  template <typename T>
+  UniquePtr<T> makeUnique(size_t size) {
+    return UniquePtr<T>((T*)allocate(size * sizeof(T)), Deleter(this));
+  }
+
+  virtual void beginRun() {}
+  virtual void endRun() {}
+
  protected:
   virtual void* allocate(size_t sizeInBytes) = 0;
   virtual void free(void* ptr) = 0;
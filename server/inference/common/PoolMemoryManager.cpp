@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/common/PoolMemoryManager.h"
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+
+namespace w2l {
+namespace streaming {
+
+namespace {
+
+// The header keeps the user memory 64-byte aligned.
+constexpr size_t kHeaderSize = 64;
+constexpr int kMinClass = 6; // 64 bytes
+constexpr int kNumClasses = 48;
+constexpr int kUnpooled = -1;
+
+struct Header {
+  int sizeClass;
+};
+
+// Free blocks of one class form a list through their first bytes.
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+// Per thread state of one PoolMemoryManager.
+struct Pool {
+  FreeBlock* freeLists[kNumClasses] = {};
+
+  ~Pool() {
+    for (auto* head : freeLists) {
+      while (head) {
+        FreeBlock* next = head->next;
+        std::free(reinterpret_cast<char*>(head) - kHeaderSize);
+        head = next;
+      }
+    }
+  }
+};
+
+Pool& threadPool(const PoolMemoryManager* manager) {
+  thread_local std::unordered_map<const PoolMemoryManager*, Pool> pools;
+  return pools[manager];
+}
+
+int sizeClass(size_t size) {
+  int cls = kMinClass;
+  while ((size_t(1) << cls) < size) {
+    ++cls;
+  }
+  return cls;
+}
+
+} // namespace
+
+PoolMemoryManager::PoolMemoryManager(size_t maxPooledSize)
+    : maxPooledSize_(maxPooledSize),
+      nAllocations_(0),
+      nHeapAllocations_(0),
+      pooledBytes_(0) {}
+
+void* PoolMemoryManager::allocate(size_t sizeInBytes) {
+  nAllocations_.fetch_add(1, std::memory_order_relaxed);
+  int cls = kUnpooled;
+  size_t size = sizeInBytes;
+  if (sizeInBytes <= maxPooledSize_) {
+    cls = sizeClass(sizeInBytes);
+    size = size_t(1) << cls;
+    Pool& pool = threadPool(this);
+    if (FreeBlock* block = pool.freeLists[cls - kMinClass]) {
+      pool.freeLists[cls - kMinClass] = block->next;
+      pooledBytes_.fetch_sub(size, std::memory_order_relaxed);
+      return block;
+    }
+  }
+
+  // aligned_alloc wants a multiple of the alignment.
+  const size_t total =
+      kHeaderSize + ((size + kHeaderSize - 1) & ~(kHeaderSize - 1));
+  char* data = static_cast<char*>(std::aligned_alloc(kHeaderSize, total));
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  nHeapAllocations_.fetch_add(1, std::memory_order_relaxed);
+  reinterpret_cast<Header*>(data)->sizeClass = cls;
+  return data + kHeaderSize;
+}
+
+void PoolMemoryManager::free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  char* data = static_cast<char*>(ptr) - kHeaderSize;
+  const int cls = reinterpret_cast<Header*>(data)->sizeClass;
+  if (cls == kUnpooled) {
+    std::free(data);
+    return;
+  }
+  // Memory freed on another thread than it was allocated on joins the free
+  // list of the freeing thread.
+  Pool& pool = threadPool(this);
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  block->next = pool.freeLists[cls - kMinClass];
+  pool.freeLists[cls - kMinClass] = block;
+  pooledBytes_.fetch_add(size_t(1) << cls, std::memory_order_relaxed);
+}
+
+std::string PoolMemoryManager::debugString() const {
+  std::stringstream ss;
+  ss << "PoolMemoryManager:{maxPooledSize=" << maxPooledSize_
+     << " allocations=" << nAllocations_.load()
+     << " heapAllocations=" << nHeapAllocations_.load()
+     << " pooledBytes=" << pooledBytes_.load() << "}";
+  return ss.str();
+}
+
+} // namespace streaming
+} // namespace w2l
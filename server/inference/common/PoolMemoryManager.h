@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "inference/common/MemoryManager.h"
+
+namespace w2l {
+namespace streaming {
+
+// Caches freed memory in per thread free lists of power of two size classes
+// and serves later allocations of the same class from them. Unlike the arena,
+// memory may outlive a run and be freed in any order. Allocations above
+// maxPooledSize go straight to the heap.
+class PoolMemoryManager : public MemoryManager {
+ public:
+  explicit PoolMemoryManager(size_t maxPooledSize = 64 << 20);
+
+  virtual ~PoolMemoryManager() override = default;
+
+  std::string debugString() const override;
+
+ protected:
+  void* allocate(size_t sizeInBytes) override;
+  void free(void* ptr) override;
+
+ private:
+  const size_t maxPooledSize_;
+
+  // Stats
+  std::atomic<uint64_t> nAllocations_;
+  std::atomic<uint64_t> nHeapAllocations_;
+  std::atomic<uint64_t> pooledBytes_;
+};
+
+} // namespace streaming
+} // namespace w2l
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include "inference/common/ArenaMemoryManager.h"
 #include "inference/common/DataType.h"
+#include "inference/common/Decimator.h"
 #include "inference/common/Functions.h"
 #include "inference/common/IOBuffer.h"
 #include "inference/common/MemoryManager.h"
+#include "inference/common/PoolMemoryManager.h"
@@ -17,6 +17,7 @@
 #include "flashlight/lib/text/decoder/lm/ZeroLM.h"
 #include "flashlight/pkg/speech/common/Defines.h"
 #include "flashlight/pkg/speech/decoder/TranscriptionUtils.h"
+#include "inference/common/Functions.h"
 #include "inference/decoder/Decoder.h"
 
 namespace w2l {
@@ -103,13 +104,17 @@ Decoder DecoderFactory::createDecoder(
   auto decoder = std::make_shared<fl::lib::text::LexiconDecoder>(
       opt, trie_, lm_, silence_, blank_, unk_, transitions_, false);
   std::cerr << "Creating LexiconDecoder instance.\n";
-  return Decoder(this, decoder);
+  return Decoder(shared_from_this(), decoder);
 }
 
 size_t DecoderFactory::alphabetSize() const {
   return alphabetSize_;
 }
 
+int DecoderFactory::blankIndex() const {
+  return blank_;
+}
+
 std::vector<WordUnit> DecoderFactory::result2Words(
     const fl::lib::text::DecodeResult& result) const {
   int seqLength = result.tokens.size();
@@ -226,8 +231,30 @@ std::string DecoderFactory::unpackReplabels(const std::string& input) const {
 
 /* ===================== Decoder===================== */
 
+void Decoder::setBlankSkipThreshold(float threshold) {
+  if (threshold > 0 && factory_->blankIndex() < 0) {
+    throw std::invalid_argument(
+        "Decoder::setBlankSkipThreshold(threshold=" +
+        std::to_string(threshold) + ") the alphabet has no blank token.");
+  }
+  if (threshold > 1) {
+    throw std::invalid_argument(
+        "Decoder::setBlankSkipThreshold(threshold=" +
+        std::to_string(threshold) + ") threshold must be at most 1.");
+  }
+  blankSkipThreshold_ = threshold;
+}
+
 void Decoder::start() {
   decoder_->decodeBegin();
+  blankSkipping_ = blankSkipThreshold_ > 0;
+  prevBlank_ = false;
+  nFrames_ = 0;
+  nSkippedFrames_ = 0;
+  nDecodedFrames_ = 0;
+  nPrunedFrames_ = 0;
+  frameMap_.clear();
+  frameMapOffset_ = 0;
 }
 
 void Decoder::run(const float* input, size_t size) {
@@ -244,20 +271,110 @@ void Decoder::run(const float* input, size_t size) {
         ") alphabet size=" + std::to_string(N));
   }
   const int T = size / factory_->alphabetSize();
-  decoder_->decodeStep(input, T, N);
+  if (!blankSkipping_) {
+    decoder_->decodeStep(input, T, N);
+    return;
+  }
+
+  const float logThreshold = std::log(blankSkipThreshold_);
+  const int blank = factory_->blankIndex();
+  float topValue;
+  int topIndex;
+  // Kept frames are decoded in contiguous runs straight from the input.
+  int runBegin = 0;
+  int runLength = 0;
+  for (int t = 0; t < T; ++t) {
+    const float* frame = input + t * N;
+    const float logSumExp = logSumExpTopK(frame, N, 1, &topValue, &topIndex);
+    const bool isBlank = frame[blank] - logSumExp >= logThreshold;
+    const int inputFrame = nFrames_++;
+    if (isBlank && prevBlank_) {
+      if (runLength > 0) {
+        decoder_->decodeStep(input + runBegin * N, runLength, N);
+        runLength = 0;
+      }
+      ++nSkippedFrames_;
+      continue;
+    }
+    prevBlank_ = isBlank;
+    if (runLength == 0) {
+      runBegin = t;
+    }
+    ++runLength;
+    frameMap_.push_back(inputFrame);
+    ++nDecodedFrames_;
+  }
+  if (runLength > 0) {
+    decoder_->decodeStep(input + runBegin * N, runLength, N);
+  }
 }
 
 void Decoder::finish() {
   decoder_->decodeEnd();
+  if (!blankSkipping_) {
+    return;
+  }
+  // decodeEnd() steps the beam search once more, to a frame after the last
+  // input frame.
+  const int nFrames = nPrunedFrames_ + decoder_->nDecodedFramesInBuffer() - 1;
+  for (; nDecodedFrames_ < nFrames; ++nDecodedFrames_) {
+    frameMap_.push_back(nFrames_);
+  }
 }
 
 std::vector<WordUnit> Decoder::getBestHypothesisInWords(int lookBack) const {
   fl::lib::text::DecodeResult rawResult = decoder_->getBestHypothesis(lookBack);
-  return factory_->result2Words(rawResult);
+  std::vector<WordUnit> words = factory_->result2Words(rawResult);
+  if (blankSkipping_) {
+    // Hypothesis position i is decoded frame nPrunedFrames_ + i - 1, position
+    // 0 being the state left by pruning. Express it in input frames counted
+    // from the same state.
+    const int origin = inputFrame(nPrunedFrames_ - 1);
+    for (auto& word : words) {
+      word.beginTimeFrame =
+          inputFrame(nPrunedFrames_ + word.beginTimeFrame - 1) - origin;
+      word.endTimeFrame =
+          inputFrame(nPrunedFrames_ + word.endTimeFrame - 1) - origin;
+    }
+  }
+  return words;
 }
 
 void Decoder::prune(int lookBack) {
   decoder_->prune(lookBack);
+  if (!blankSkipping_) {
+    return;
+  }
+  // The beam search moves lookBack back to the last completed word and may
+  // not prune at all, so take the count from the frames it still holds: its
+  // buffer starts with the frame before the first unpruned one, which anchors
+  // hypothesis position 0.
+  nPrunedFrames_ = nDecodedFrames_ + 1 - decoder_->nDecodedFramesInBuffer();
+  const int firstKept = nPrunedFrames_ - 1;
+  if (firstKept > frameMapOffset_) {
+    frameMap_.erase(
+        frameMap_.begin(), frameMap_.begin() + (firstKept - frameMapOffset_));
+    frameMapOffset_ = firstKept;
+  }
+}
+
+int Decoder::skippedFrames() const {
+  return nSkippedFrames_;
+}
+
+int Decoder::inputFrame(int decodedFrame) const {
+  if (decodedFrame < 0) {
+    return -1;
+  }
+  const int i = decodedFrame - frameMapOffset_;
+  if (i < 0 || i >= static_cast<int>(frameMap_.size())) {
+    throw std::out_of_range(
+        "Decoder::inputFrame(decodedFrame=" + std::to_string(decodedFrame) +
+        ") frame is not in the retained window [" +
+        std::to_string(frameMapOffset_) + ", " +
+        std::to_string(frameMapOffset_ + frameMap_.size()) + ").");
+  }
+  return frameMap_[i];
 }
 
 } // namespace streaming
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
+
 #include "flashlight/lib/text/decoder/Decoder.h"
 #include "flashlight/lib/text/decoder/LexiconDecoder.h"
 #include "flashlight/lib/text/decoder/Trie.h"
@@ -34,8 +37,10 @@ class Decoder;
 // Implementation of Decoder Factory that loads and initializes common decoder
 // parameters that are shared across different Decoder instances. This class
 // is thread safe and supports creation of Decoder instances that can be used
-// to decode streams.
-class DecoderFactory {
+// to decode streams. It is immutable after construction and must be owned by a
+// std::shared_ptr: decoders keep a reference to it instead of a copy, so
+// dictionaries, trie and LM exist once no matter how many streams are open.
+class DecoderFactory : public std::enable_shared_from_this<DecoderFactory> {
  public:
   // Loads all the parameters and initializes decoder model.
   DecoderFactory(
@@ -47,6 +52,9 @@ class DecoderFactory {
       const std::string& silenceToken,
       const int repetitionLabel);
 
+  DecoderFactory(const DecoderFactory&) = delete;
+  DecoderFactory& operator=(const DecoderFactory&) = delete;
+
   // Creates provided Decoder instance with specified options and allocator.
   // The Decoder instance uses provided allocator to manage its memory.
   Decoder createDecoder(
@@ -59,6 +67,9 @@ class DecoderFactory {
   // Returns size of the alphabet (=dimension of transitions matrix).
   size_t alphabetSize() const;
 
+  // Returns index of the CTC blank token or -1 if the alphabet has none.
+  int blankIndex() const;
+
  private:
   fl::lib::text::Dictionary wordMap_;
   fl::lib::text::Dictionary letterMap_;
@@ -84,10 +95,16 @@ class Decoder {
   Decoder() {}
 
   Decoder(
-      const DecoderFactory* factory,
+      std::shared_ptr<const DecoderFactory> factory,
       std::shared_ptr<fl::lib::text::Decoder> decoder)
-      : factory_(std::make_shared<DecoderFactory>(*factory)),
-        decoder_(decoder) {}
+      : factory_(std::move(factory)), decoder_(std::move(decoder)) {}
+
+  // Enables CTC blank skipping. A frame whose blank posterior is at least
+  // threshold only separates tokens, so of each run of such frames only the
+  // first one reaches the beam search. Times in WordUnit keep counting all
+  // frames. threshold <= 0 disables skipping, which is the default. Takes
+  // effect on the next start().
+  void setBlankSkipThreshold(float threshold);
 
   void start();
 
@@ -100,9 +117,28 @@ class Decoder {
   /* Prune the hypothesis space */
   void prune(int lookBack = 0);
 
+  // Number of frames dropped by blank skipping since start().
+  int skippedFrames() const;
+
  private:
-  const std::shared_ptr<DecoderFactory> factory_;
+  const std::shared_ptr<const DecoderFactory> factory_;
   std::shared_ptr<fl::lib::text::Decoder> decoder_;
+
+  float blankSkipThreshold_ = 0;
+  bool blankSkipping_ = false;
+  // Blank skipping state.
+  bool prevBlank_ = false;
+  int nFrames_ = 0;
+  int nSkippedFrames_ = 0;
+  // Frames seen by the beam search and how many of them it pruned.
+  int nDecodedFrames_ = 0;
+  int nPrunedFrames_ = 0;
+  // frameMap_[i] is the input frame of decoded frame frameMapOffset_ + i.
+  std::vector<int> frameMap_;
+  int frameMapOffset_ = 0;
+
+  // Input frame of a decoded frame, -1 for the frame before the first.
+  int inputFrame(int decodedFrame) const;
 };
 
 } // namespace streaming
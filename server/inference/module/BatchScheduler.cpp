@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/module/BatchScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+
+namespace w2l {
+namespace streaming {
+
+BatchScheduler::BatchScheduler(
+    std::shared_ptr<InferenceModule> module,
+    int maxBatchSize,
+    std::chrono::microseconds maxWait)
+    : module_(module),
+      maxBatchSize_(maxBatchSize),
+      maxWait_(maxWait),
+      nStreams_(0),
+      nBatches_(0),
+      nRequests_(0),
+      maxObservedBatchSize_(0) {
+  if (!module || maxBatchSize <= 0 || maxWait.count() < 0) {
+    std::stringstream ss;
+    ss << "Invalid argument at BatchScheduler::BatchScheduler(module="
+       << (module ? module->debugString() : "nullptr")
+       << " maxBatchSize=" << maxBatchSize
+       << " maxWait=" << maxWait.count() << "us)";
+    throw std::invalid_argument(ss.str());
+  }
+}
+
+std::shared_ptr<ModuleProcessingState> BatchScheduler::run(
+    std::shared_ptr<ModuleProcessingState> input) {
+  assert(input);
+  Request request;
+  request.input = input;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.push_back(&request);
+  if (pending_.size() == 1) {
+    // Leader of a new batch.
+    batchFull_.wait_for(
+        lock, maxWait_, [this]() { return pending_.size() >= batchTarget(); });
+    std::vector<Request*> batch;
+    batch.swap(pending_);
+    ++nBatches_;
+    nRequests_ += batch.size();
+    maxObservedBatchSize_ = std::max<int>(maxObservedBatchSize_, batch.size());
+    lock.unlock();
+
+    execute(batch);
+
+    lock.lock();
+    for (Request* r : batch) {
+      r->done = true;
+    }
+    batchDone_.notify_all();
+  } else {
+    if (pending_.size() >= batchTarget()) {
+      batchFull_.notify_all();
+    }
+    batchDone_.wait(lock, [&request]() { return request.done; });
+  }
+  lock.unlock();
+
+  if (request.error) {
+    std::rethrow_exception(request.error);
+  }
+  return request.output;
+}
+
+void BatchScheduler::execute(const std::vector<Request*>& batch) {
+  std::vector<std::shared_ptr<ModuleProcessingState>> inputs;
+  inputs.reserve(batch.size());
+  for (Request* r : batch) {
+    inputs.push_back(r->input);
+  }
+  try {
+    std::vector<std::shared_ptr<ModuleProcessingState>> outputs =
+        module_->runBatch(inputs);
+    assert(outputs.size() == batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+      batch[i]->output = outputs[i];
+    }
+  } catch (...) {
+    // The streams of a batch share the failure, their states are undefined.
+    std::exception_ptr error = std::current_exception();
+    for (Request* r : batch) {
+      r->error = error;
+    }
+  }
+}
+
+void BatchScheduler::addStream() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++nStreams_;
+}
+
+void BatchScheduler::removeStream() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  assert(nStreams_ > 0);
+  --nStreams_;
+  // The forming batch may now hold every remaining stream.
+  batchFull_.notify_all();
+}
+
+size_t BatchScheduler::batchTarget() const {
+  return static_cast<size_t>(std::min(maxBatchSize_, std::max(nStreams_, 1)));
+}
+
+std::string BatchScheduler::debugString() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::stringstream ss;
+  ss << "BatchScheduler:{maxBatchSize=" << maxBatchSize_
+     << " maxWait=" << maxWait_.count() << "us"
+     << " nStreams=" << nStreams_ << " nBatches=" << nBatches_
+     << " nRequests=" << nRequests_
+     << " avgBatchSize="
+     << (nBatches_ ? static_cast<double>(nRequests_) / nBatches_ : 0.0)
+     << " maxObservedBatchSize=" << maxObservedBatchSize_ << "}";
+  return ss.str();
+}
+
+} // namespace streaming
+} // namespace w2l
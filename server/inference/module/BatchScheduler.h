@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "inference/module/InferenceModule.h"
+#include "inference/module/ModuleProcessingState.h"
+
+namespace w2l {
+namespace streaming {
+
+// Collects chunks that are ready from concurrent streams and runs them through
+// the module as a single batch with InferenceModule::runBatch().
+//
+// There is no scheduler thread. The first caller that finds no batch forming
+// becomes its leader: it waits up to maxWait for other streams to join, then
+// runs the whole batch and wakes up the other callers. Callers that arrive
+// while a batch is running form the next one. All streams must have been
+// started with the same module.
+//
+// Streams register with addStream() and removeStream(). The leader only waits
+// while some registered stream has not joined the batch, so a single stream
+// never waits.
+class BatchScheduler {
+ public:
+  BatchScheduler(
+      std::shared_ptr<InferenceModule> module,
+      int maxBatchSize,
+      std::chrono::microseconds maxWait);
+
+  // Blocks until the input is processed and returns the output state, same as
+  // module->run(input) would.
+  std::shared_ptr<ModuleProcessingState> run(
+      std::shared_ptr<ModuleProcessingState> input);
+
+  // Counts the streams that may call run().
+  void addStream();
+  void removeStream();
+
+  std::string debugString() const;
+
+ private:
+  struct Request {
+    std::shared_ptr<ModuleProcessingState> input;
+    std::shared_ptr<ModuleProcessingState> output;
+    std::exception_ptr error;
+    bool done = false;
+  };
+
+  void execute(const std::vector<Request*>& batch);
+
+  // Size at which a forming batch stops waiting for more streams.
+  size_t batchTarget() const;
+
+  std::shared_ptr<InferenceModule> module_;
+  const int maxBatchSize_;
+  const std::chrono::microseconds maxWait_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable batchFull_;
+  std::condition_variable batchDone_;
+  std::vector<Request*> pending_;
+  int nStreams_;
+
+  // Stats
+  uint64_t nBatches_;
+  uint64_t nRequests_;
+  int maxObservedBatchSize_;
+};
+
+} // namespace streaming
+} // namespace w2l
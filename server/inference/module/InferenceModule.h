@@ -48,8 +48,22 @@ class InferenceModule {
     return run(input);
   }
 
+  // Same as run() for the states of several independent streams. Returns the
+  // output states in the order of the inputs. The default runs the streams one
+  // after another. Modules with large weights override it to stack the frames
+  // of all streams into a single matrix, so the weights are read once per
+  // batch instead of once per stream.
+  virtual std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs);
+
   virtual void clear() {}
 
+  // Number of input frames consumed per output frame. For a whole graph it is
+  // the number of audio samples behind each output frame.
+  virtual int stride() const {
+    return 1;
+  }
+
   virtual void setMemoryManager(std::shared_ptr<MemoryManager> memoryManager);
 
   virtual std::string debugString() const = 0;
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/module/MappedModel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+
+namespace w2l {
+namespace streaming {
+
+namespace {
+
+constexpr char kMagic[8] = {'W', '2', 'L', 'M', 'M', 'A', 'P', '\0'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+thread_local MappedModelWriter* writer = nullptr;
+thread_local MappedModelReader* reader = nullptr;
+
+uint64_t alignUp(uint64_t value) {
+  return (value + kMappedModelAlignment - 1) & ~(kMappedModelAlignment - 1);
+}
+
+void writePadding(std::ostream& out, uint64_t size) {
+  static const char zeros[kMappedModelAlignment] = {};
+  out.write(zeros, size);
+}
+
+// Read-only view of an archive inside the mapping, avoids copying it into a
+// stringstream.
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char* data, uint64_t size) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+struct Mapping {
+  void* data = MAP_FAILED;
+  size_t size = 0;
+
+  ~Mapping() {
+    if (data != MAP_FAILED) {
+      munmap(data, size);
+    }
+  }
+};
+
+std::shared_ptr<Mapping> mapFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") open failed: " +
+        std::strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") fstat failed: " +
+        std::strerror(error));
+  }
+  auto mapping = std::make_shared<Mapping>();
+  mapping->size = st.st_size;
+  if (mapping->size > 0) {
+    mapping->data =
+        mmap(nullptr, mapping->size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  int error = errno;
+  close(fd);
+  if (mapping->data == MAP_FAILED) {
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") mmap failed: " +
+        (mapping->size > 0 ? std::strerror(error) : "empty file"));
+  }
+  return mapping;
+}
+
+// FNV-1a over the bytes of value.
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    hash ^= (value >> (8 * i)) & 0xff;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+} // namespace
+
+uint64_t mappedModelSourceStamp(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    throw std::runtime_error(
+        "mappedModelSourceStamp(path=" + path + ") stat failed: " +
+        std::strerror(errno));
+  }
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = hashCombine(hash, st.st_size);
+  hash = hashCombine(hash, st.st_mtim.tv_sec);
+  hash = hashCombine(hash, st.st_mtim.tv_nsec);
+  return hash == 0 ? 1 : hash;
+}
+
+uint64_t MappedModelWriter::addBlob(const void* data, uint64_t size) {
+  const uint64_t offset = alignUp(blobSize_);
+  blobs_.push_back({data, offset, size});
+  blobSize_ = offset + size;
+  return offset;
+}
+
+void MappedModelWriter::writeBlobs(std::ostream& out) const {
+  uint64_t position = 0;
+  for (const auto& blob : blobs_) {
+    writePadding(out, blob.offset - position);
+    out.write(static_cast<const char*>(blob.data), blob.size);
+    position = blob.offset + blob.size;
+  }
+}
+
+MappedModelReader::MappedModelReader(
+    std::shared_ptr<const void> mapping,
+    const char* blobs,
+    uint64_t blobSize)
+    : mapping_(std::move(mapping)), blobs_(blobs), blobSize_(blobSize) {}
+
+const void* MappedModelReader::blob(uint64_t offset, uint64_t size) const {
+  if (offset % kMappedModelAlignment != 0 || offset > blobSize_ ||
+      size > blobSize_ - offset) {
+    std::stringstream ss;
+    ss << "MappedModelReader::blob(offset=" << offset << " size=" << size
+       << ") invalid blob, blob section size=" << blobSize_;
+    throw std::runtime_error(ss.str());
+  }
+  return blobs_ + offset;
+}
+
+MappedModelWriter* currentMappedModelWriter() {
+  return writer;
+}
+
+MappedModelReader* currentMappedModelReader() {
+  return reader;
+}
+
+void saveMappedModel(
+    std::shared_ptr<InferenceModule> module,
+    const std::string& path,
+    uint64_t sourceStamp) {
+  MappedModelWriter blobWriter;
+  std::stringstream archiveStream;
+  writer = &blobWriter;
+  try {
+    cereal::BinaryOutputArchive archive(archiveStream);
+    archive(module);
+  } catch (...) {
+    writer = nullptr;
+    throw;
+  }
+  writer = nullptr;
+  const std::string archiveData = archiveStream.str();
+
+  MappedModelHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kMappedModelVersion;
+  header.byteOrderMark = kByteOrderMark;
+  header.headerSize = sizeof(MappedModelHeader);
+  header.alignment = kMappedModelAlignment;
+  header.archiveOffset = sizeof(MappedModelHeader);
+  header.archiveSize = archiveData.size();
+  header.blobOffset = alignUp(header.archiveOffset + header.archiveSize);
+  header.blobSize = blobWriter.blobSize();
+  header.sourceStamp = sourceStamp;
+
+  const std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      throw std::runtime_error(
+          "saveMappedModel(path=" + path + ") failed to open " + tmpPath);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(archiveData.data(), archiveData.size());
+    writePadding(
+        out, header.blobOffset - header.archiveOffset - header.archiveSize);
+    blobWriter.writeBlobs(out);
+    out.flush();
+    if (!out) {
+      std::remove(tmpPath.c_str());
+      throw std::runtime_error(
+          "saveMappedModel(path=" + path + ") failed to write " + tmpPath);
+    }
+  }
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::remove(tmpPath.c_str());
+    throw std::runtime_error(
+        "saveMappedModel(path=" + path + ") rename failed: " +
+        std::strerror(errno));
+  }
+}
+
+std::shared_ptr<InferenceModule> loadMappedModel(
+    const std::string& path,
+    uint64_t sourceStamp) {
+  std::shared_ptr<Mapping> mapping = mapFile(path);
+  const char* base = static_cast<const char*>(mapping->data);
+
+  MappedModelHeader header;
+  if (mapping->size < sizeof(header)) {
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") file too small");
+  }
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") not a mapped model");
+  }
+  if (header.byteOrderMark != kByteOrderMark ||
+      header.version != kMappedModelVersion ||
+      header.headerSize != sizeof(MappedModelHeader) ||
+      header.alignment != kMappedModelAlignment) {
+    std::stringstream ss;
+    ss << "loadMappedModel(path=" << path
+       << ") unsupported version=" << header.version
+       << " expected=" << kMappedModelVersion;
+    throw std::runtime_error(ss.str());
+  }
+  if (header.archiveOffset > mapping->size ||
+      header.archiveSize > mapping->size - header.archiveOffset ||
+      header.blobOffset % kMappedModelAlignment != 0 ||
+      header.blobOffset > mapping->size ||
+      header.blobSize > mapping->size - header.blobOffset) {
+    throw std::runtime_error(
+        "loadMappedModel(path=" + path + ") truncated file");
+  }
+  if (sourceStamp != 0 && header.sourceStamp != sourceStamp) {
+    std::stringstream ss;
+    ss << "loadMappedModel(path=" << path
+       << ") stale, sourceStamp=" << header.sourceStamp
+       << " expected=" << sourceStamp;
+    throw std::runtime_error(ss.str());
+  }
+
+  MappedModelReader blobReader(
+      mapping, base + header.blobOffset, header.blobSize);
+  MemoryStreamBuf archiveBuf(base + header.archiveOffset, header.archiveSize);
+  std::istream archiveStream(&archiveBuf);
+  std::shared_ptr<InferenceModule> module;
+  reader = &blobReader;
+  try {
+    cereal::BinaryInputArchive archive(archiveStream);
+    archive(module);
+  } catch (...) {
+    reader = nullptr;
+    throw;
+  }
+  reader = nullptr;
+  return module;
+}
+
+} // namespace streaming
+} // namespace w2l
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inference/module/InferenceModule.h"
+
+namespace w2l {
+namespace streaming {
+
+// Memory mapped model file.
+//
+// Layout, all offsets from the start of the file:
+//   [0, 64)            MappedModelHeader
+//   [archiveOffset, +) cereal binary archive of the module graph
+//   [blobOffset, +)    raw weight blobs, each 64-byte aligned
+//
+// The archive is the regular cereal serialization except that large weights
+// store an offset into the blob section instead of their content. Blobs are
+// kept in the layout the backend computes with (for fbgemm the packed FP16
+// matrix), so loading points the weights into the mapping without copying or
+// repacking, and all processes mapping the file share the page cache.
+constexpr uint32_t kMappedModelVersion = 1;
+constexpr uint64_t kMappedModelAlignment = 64;
+
+struct MappedModelHeader {
+  char magic[8];
+  uint32_t version;
+  // Written as 0x01020304 to detect files from a different byte order.
+  uint32_t byteOrderMark;
+  uint32_t headerSize;
+  uint32_t alignment;
+  uint64_t archiveOffset;
+  uint64_t archiveSize;
+  uint64_t blobOffset;
+  uint64_t blobSize;
+  // mappedModelSourceStamp() of the file the model was converted from. 0 means
+  // the source is unknown, and the file only loads when no stamp is expected.
+  uint64_t sourceStamp;
+};
+
+static_assert(
+    sizeof(MappedModelHeader) == kMappedModelAlignment,
+    "MappedModelHeader must fill exactly one alignment unit");
+
+// Collects the blobs while a model is saved by saveMappedModel().
+class MappedModelWriter {
+ public:
+  // Registers size bytes at data to be written to the blob section and returns
+  // their offset in it. data must stay valid until the model is written.
+  uint64_t addBlob(const void* data, uint64_t size);
+
+  uint64_t blobSize() const {
+    return blobSize_;
+  }
+
+  void writeBlobs(std::ostream& out) const;
+
+ private:
+  struct Blob {
+    const void* data;
+    uint64_t offset;
+    uint64_t size;
+  };
+  std::vector<Blob> blobs_;
+  uint64_t blobSize_ = 0;
+};
+
+// Gives access to the blobs while a model is loaded by loadMappedModel().
+class MappedModelReader {
+ public:
+  MappedModelReader(
+      std::shared_ptr<const void> mapping,
+      const char* blobs,
+      uint64_t blobSize);
+
+  // Returns a pointer to the blob, throws if it is outside the blob section or
+  // misaligned.
+  const void* blob(uint64_t offset, uint64_t size) const;
+
+  // Keeps the mapping alive, objects pointing into the blobs must hold it.
+  std::shared_ptr<const void> mapping() const {
+    return mapping_;
+  }
+
+ private:
+  std::shared_ptr<const void> mapping_;
+  const char* blobs_;
+  uint64_t blobSize_;
+};
+
+// Non-null only on the thread running saveMappedModel() / loadMappedModel().
+// Serializers of large weights use them to store blobs instead of content.
+MappedModelWriter* currentMappedModelWriter();
+MappedModelReader* currentMappedModelReader();
+
+// Hash of the size and modification time of the file at path, never 0.
+// Throws if the file does not exist.
+uint64_t mappedModelSourceStamp(const std::string& path);
+
+// Writes the module to path. The file is written next to it and renamed, so
+// processes loading concurrently never see a partial file. sourceStamp is
+// stored in the header to detect a replaced source later.
+void saveMappedModel(
+    std::shared_ptr<InferenceModule> module,
+    const std::string& path,
+    uint64_t sourceStamp = 0);
+
+// Maps the file read-only and deserializes the module. Throws if the file is
+// missing, truncated, of another version or layout, or if sourceStamp is not
+// 0 and differs from the one the file was saved with.
+std::shared_ptr<InferenceModule> loadMappedModel(
+    const std::string& path,
+    uint64_t sourceStamp = 0);
+
+} // namespace streaming
+} // namespace w2l
@@ -7,11 +7,24 @@
 
 #include "inference/module/feature/LogMelFeature.h"
 
+#include <algorithm>
 #include <cassert>
-#include <numeric>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
 
+namespace {
+
+double hertzToMel(double hz) {
+  return 2595.0 * std::log10(1.0 + hz / 700.0);
+}
+
+double melToHertz(double mel) {
+  return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+}
+
+} // namespace
+
 namespace w2l {
 namespace streaming {
 
@@ -19,7 +32,11 @@ LogMelFeature::LogMelFeature()
     : numFilters_(0),
       frameSizeMs_(25),
       frameShiftMs_(10),
-      samplingFreq_(16000) {}
+      samplingFreq_(16000),
+      frameSize_(0),
+      frameStride_(0),
+      nFft_(0),
+      nBins_(0) {}
 
 LogMelFeature::LogMelFeature(
     int numFilters,
@@ -29,9 +46,13 @@ LogMelFeature::LogMelFeature(
     : numFilters_(numFilters),
       frameSizeMs_(frameSizeMs),
       frameShiftMs_(frameShiftMs),
-      samplingFreq_(samplingFreq) {
+      samplingFreq_(samplingFreq),
+      frameSize_(0),
+      frameStride_(0),
+      nFft_(0),
+      nBins_(0) {
   init();
-  assert(mfscFeaturizer_);
+  assert(!window_.empty());
 }
 
 std::shared_ptr<ModuleProcessingState> LogMelFeature::start(
@@ -51,19 +72,106 @@ std::shared_ptr<ModuleProcessingState> LogMelFeature::run(
   std::shared_ptr<IOBuffer> outputBuf = output->buffer(0);
   assert(outputBuf);
 
-  auto numFrames = featParams_.numFrames(inputSize);
+  const int numFrames = featParams_.numFrames(inputSize);
   if (numFrames == 0) {
     return output;
   }
-  std::vector<float> inputVec(inputBuf->data<float>(), inputBuf->tail<float>());
-  auto outputVec = mfscFeaturizer_->apply(inputVec);
+  if (!memoryManager_) {
+    throw std::invalid_argument("null memoryManager_ at LogMelFeature::run()");
+  }
+  MemoryManager::RunScope runScope(memoryManager_.get());
+  const int tileFrames = std::min(numFrames, kTileFrames);
+  auto work = memoryManager_->makeUnique<float>(nFft_);
+  auto spectra = memoryManager_->makeUnique<float>(tileFrames * nBins_);
+  assert(work && spectra);
+
+  outputBuf->ensure<float>(numFrames * numFilters_);
+  const float* in = inputBuf->data<float>();
+  float* out = outputBuf->tail<float>();
+  const float melFloor = featParams_.melFloor;
+  for (int t0 = 0; t0 < numFrames; t0 += tileFrames) {
+    const int n = std::min(tileFrames, numFrames - t0);
+    for (int i = 0; i < n; ++i) {
+      magnitudeSpectrum(
+          in + (t0 + i) * frameStride_,
+          work.get(),
+          spectra.get() + i * nBins_);
+    }
+    // Projects the tile onto the filterbank. Each filter only covers the bins
+    // between its neighbours, so only those are multiplied.
+    for (int i = 0; i < n; ++i) {
+      const float* spectrum = spectra.get() + i * nBins_;
+      float* frameOut = out + (t0 + i) * numFilters_;
+      for (int j = 0; j < numFilters_; ++j) {
+        const MelFilter& filter = melFilters_[j];
+        const float* weights = melWeights_.data() + filter.offset;
+        const float* bins = spectrum + filter.begin;
+        float sum = 0.0;
+        for (int k = 0; k < filter.size; ++k) {
+          sum += weights[k] * bins[k];
+        }
+        frameOut[j] = std::log(std::max(sum, melFloor));
+      }
+    }
+  }
 
-  assert(outputVec.size() == numFrames * numFilters_);
-  outputBuf->write<float>(outputVec.data(), outputVec.size());
-  inputBuf->consume<float>(numFrames * featParams_.numFrameStrideSamples());
+  outputBuf->move<float>(numFrames * numFilters_);
+  inputBuf->consume<float>(numFrames * frameStride_);
   return output;
 }
 
+void LogMelFeature::magnitudeSpectrum(
+    const float* in,
+    float* work,
+    float* spectrum) const {
+  const int half = nFft_ / 2;
+  float* re = work;
+  float* im = work + half;
+
+  // Pre-emphasis and window, with the even samples packed into the real and
+  // the odd samples into the imaginary part, in bit reversed order.
+  const float preem = featParams_.preemCoef;
+  std::fill_n(work, nFft_, 0.0f);
+  for (int n = 0; n < frameSize_; ++n) {
+    const float x = n == 0 ? in[0] * (1.0f - preem) : in[n] - preem * in[n - 1];
+    const int pos = bitReverse_[n / 2];
+    (n % 2 == 0 ? re : im)[pos] = x * window_[n];
+  }
+
+  // Radix 2 decimation in time.
+  for (int size = 2; size <= half; size *= 2) {
+    const int step = half / size;
+    for (int start = 0; start < half; start += size) {
+      for (int k = 0; k < size / 2; ++k) {
+        const float wr = twiddleRe_[k * step];
+        const float wi = twiddleIm_[k * step];
+        const int a = start + k;
+        const int b = a + size / 2;
+        const float tr = wr * re[b] - wi * im[b];
+        const float ti = wr * im[b] + wi * re[b];
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+
+  // X[k] = E[k] + W^k O[k] with E and O the transforms of the even and odd
+  // samples, recovered from Z[k] and conj(Z[half - k]).
+  for (int k = 0; k <= half; ++k) {
+    const int k1 = k % half;
+    const int k2 = (half - k) % half;
+    const float er = 0.5f * (re[k1] + re[k2]);
+    const float ei = 0.5f * (im[k1] - im[k2]);
+    const float orr = 0.5f * (im[k1] + im[k2]);
+    const float oi = -0.5f * (re[k1] - re[k2]);
+    const float xr = er + splitRe_[k] * orr - splitIm_[k] * oi;
+    const float xi = ei + splitRe_[k] * oi + splitIm_[k] * orr;
+    spectrum[k] = std::sqrt(xr * xr + xi * xi);
+  }
+}
+
 std::string LogMelFeature::debugString() const {
   std::stringstream ss;
   ss << "LogMelFeature:{numFilters=" << numFilters_
@@ -87,7 +195,85 @@ void LogMelFeature::init() {
   featParams_.accWindow = 0;
   featParams_.deltaWindow = 0;
 
-  mfscFeaturizer_ = std::make_shared<fl::lib::audio::Mfsc>(featParams_);
+  frameSize_ = featParams_.numFrameSizeSamples();
+  frameStride_ = featParams_.numFrameStrideSamples();
+  nFft_ = featParams_.nFft();
+  nBins_ = featParams_.filterFreqResponseLen();
+  if (numFilters_ <= 0 || frameSize_ <= 1 || frameStride_ <= 0 ||
+      nFft_ < frameSize_ || nFft_ < 4 || nBins_ != nFft_ / 2 + 1) {
+    std::stringstream ss;
+    ss << "Invalid parameters at LogMelFeature::init() " << debugString();
+    throw std::invalid_argument(ss.str());
+  }
+
+  window_.resize(frameSize_);
+  for (int n = 0; n < frameSize_; ++n) {
+    window_[n] = 0.54 - 0.46 * std::cos(2.0 * M_PI * n / (frameSize_ - 1));
+  }
+  initFft();
+  initFilterbank();
+}
+
+void LogMelFeature::initFft() {
+  const int half = nFft_ / 2;
+  int bits = 0;
+  while ((1 << bits) < half) {
+    ++bits;
+  }
+  bitReverse_.resize(half);
+  for (int i = 0; i < half; ++i) {
+    int reversed = 0;
+    for (int b = 0; b < bits; ++b) {
+      reversed |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    bitReverse_[i] = reversed;
+  }
+
+  twiddleRe_.resize(half / 2);
+  twiddleIm_.resize(half / 2);
+  for (int k = 0; k < half / 2; ++k) {
+    twiddleRe_[k] = std::cos(2.0 * M_PI * k / half);
+    twiddleIm_[k] = -std::sin(2.0 * M_PI * k / half);
+  }
+  splitRe_.resize(half + 1);
+  splitIm_.resize(half + 1);
+  for (int k = 0; k <= half; ++k) {
+    splitRe_[k] = std::cos(2.0 * M_PI * k / nFft_);
+    splitIm_[k] = -std::sin(2.0 * M_PI * k / nFft_);
+  }
+}
+
+void LogMelFeature::initFilterbank() {
+  // Filter edges in fractional FFT bins, evenly spaced on the mel scale.
+  const double minMel = hertzToMel(featParams_.lowFreqFilterbank);
+  const double maxMel = hertzToMel(featParams_.highFreqFilterbank);
+  const double melStep = (maxMel - minMel) / (numFilters_ + 1);
+  std::vector<float> edges(numFilters_ + 2);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    edges[i] = melToHertz(minMel + i * melStep) * (nBins_ - 1) * 2.0 /
+        samplingFreq_;
+  }
+
+  melFilters_.clear();
+  melWeights_.clear();
+  for (int j = 0; j < numFilters_; ++j) {
+    MelFilter filter = {0, 0, static_cast<int>(melWeights_.size())};
+    for (int k = 0; k < nBins_; ++k) {
+      const float rising = (k - edges[j]) / (edges[j + 1] - edges[j]);
+      const float falling = (edges[j + 2] - k) / (edges[j + 2] - edges[j + 1]);
+      const float weight = std::max(std::min(rising, falling), 0.0f);
+      if (weight > 0.0) {
+        if (filter.size == 0) {
+          filter.begin = k;
+        }
+        // Keeps the range contiguous if a weight in it is zero.
+        filter.size = k - filter.begin + 1;
+        melWeights_.resize(filter.offset + filter.size, 0.0);
+        melWeights_.back() = weight;
+      }
+    }
+    melFilters_.push_back(filter);
+  }
 }
 
 } // namespace streaming
@@ -11,9 +11,9 @@
 #include <cereal/types/polymorphic.hpp>
 #include <cstdio>
 #include <memory>
+#include <vector>
 
 #include "flashlight/lib/audio/feature/FeatureParams.h"
-#include "flashlight/lib/audio/feature/Mfsc.h"
 #include "inference/common/IOBuffer.h"
 #include "inference/module/InferenceModule.h"
 #include "inference/module/ModuleParameter.h"
@@ -21,8 +21,19 @@
 namespace w2l {
 namespace streaming {
 
+// Log mel filterbank features, computed the same way as
+// fl::lib::audio::Mfsc with the parameters set in init(): per frame
+// pre-emphasis, Hamming window, FFT magnitude, triangular mel filterbank and
+// log with a floor of melFloor.
+//
+// The window, FFT tables and filterbank are computed once by init() and are
+// shared by all streams. run() reads complete frames in place from the input
+// buffer and writes the features straight into the output buffer, so nothing
+// is allocated outside of the memory manager.
 class LogMelFeature : public InferenceModule {
  public:
+  static constexpr int kTileFrames = 16;
+
   explicit LogMelFeature(
       int numFilters,
       int frameSizeMs = 25,
@@ -37,6 +48,10 @@ class LogMelFeature : public InferenceModule {
   std::shared_ptr<ModuleProcessingState> run(
       std::shared_ptr<ModuleProcessingState> input) override;
 
+  int stride() const override {
+    return samplingFreq_ * frameShiftMs_ / 1000;
+  }
+
   std::string debugString() const override;
 
  private:
@@ -45,12 +60,42 @@ class LogMelFeature : public InferenceModule {
   int32_t frameShiftMs_;
   int32_t samplingFreq_;
   fl::lib::audio::FeatureParams featParams_;
-  std::shared_ptr<fl::lib::audio::Mfsc> mfscFeaturizer_;
+
+  // Non zero weights of one mel filter over FFT bins [begin, begin + size),
+  // stored in melWeights_ from offset.
+  struct MelFilter {
+    int begin;
+    int size;
+    int offset;
+  };
+
+  int frameSize_;
+  int frameStride_;
+  int nFft_;
+  int nBins_;
+  std::vector<float> window_;
+  // The real FFT of size nFft_ runs as a complex FFT of size nFft_ / 2.
+  std::vector<int> bitReverse_;
+  std::vector<float> twiddleRe_;
+  std::vector<float> twiddleIm_;
+  // Twiddles splitting the half size FFT into the nBins_ real FFT bins.
+  std::vector<float> splitRe_;
+  std::vector<float> splitIm_;
+  std::vector<MelFilter> melFilters_;
+  std::vector<float> melWeights_;
 
   LogMelFeature();
 
   void init();
 
+  void initFft();
+
+  void initFilterbank();
+
+  // Writes the FFT magnitude of the frame starting at in to spectrum.
+  // work holds nFft_ floats.
+  void magnitudeSpectrum(const float* in, float* work, float* spectrum) const;
+
   friend class cereal::access;
 
   template <class Archive>
@@ -60,7 +105,7 @@ class LogMelFeature : public InferenceModule {
        frameSizeMs_,
        frameShiftMs_,
        samplingFreq_);
-    if (!mfscFeaturizer_) {
+    if (window_.empty()) {
       init();
     }
   }
@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "inference/module/BatchScheduler.h"
 #include "inference/module/InferenceModule.h"
+#include "inference/module/MappedModel.h"
 #include "inference/module/ModuleParameter.h"
 #include "inference/module/ModuleProcessingState.h"
@@ -59,6 +59,10 @@ class Conv1d : public InferenceModule {
 
   virtual ~Conv1d() override = default;
 
+  int stride() const override {
+    return stride_;
+  }
+
   std::string debugString() const override;
 
  protected:
@@ -32,9 +32,7 @@ std::shared_ptr<ModuleProcessingState> Identity::run(
   assert(!output->buffers().empty());
   std::shared_ptr<IOBuffer> outputBuf = output->buffer(0);
   assert(outputBuf);
-  auto inLen = inputBuf->size<char>();
-  outputBuf->write(inputBuf->data<char>(), inLen);
-  inputBuf->consume<char>(inLen);
+  outputBuf->splice<char>(*inputBuf, inputBuf->size<char>());
   return output;
 }
 
@@ -40,6 +40,7 @@ class LayerNorm : public InferenceModule {
 
  private:
   friend class cereal::access;
+  friend class TDSBlockFused;
 
   LayerNorm();
 
@@ -8,7 +8,7 @@
 #include "inference/module/nn/LocalNorm.h"
 
 #include <cassert>
-#include <numeric>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
 
@@ -16,7 +16,36 @@
 
 namespace {
 constexpr const float kEpsilon = 1e-5; // min stddev to avoid division by zero
-}
+
+// Kahan compensated running total.
+struct KahanSum {
+  double sum = 0.0;
+  double compensation = 0.0;
+
+  void add(double value) {
+    const double y = value - compensation;
+    const double t = sum + y;
+    compensation = (t - sum) - y;
+    sum = t;
+  }
+};
+
+// Totals over the frames in the window, kept in the third output buffer.
+struct RunningSums {
+  KahanSum sum;
+  KahanSum sqSum;
+  // Ring position of the oldest frame and number of frames in the window.
+  int32_t head = 0;
+  int32_t count = 0;
+};
+
+// Sums of one frame, kept in a ring of leftContextSize + 1 entries in the
+// second output buffer.
+struct FrameSums {
+  double sum;
+  double sqSum;
+};
+} // namespace
 
 namespace w2l {
 namespace streaming {
@@ -42,9 +71,16 @@ LocalNorm::LocalNorm(
 
 std::shared_ptr<ModuleProcessingState> LocalNorm::start(
     std::shared_ptr<ModuleProcessingState> input) {
-  // Create 3 output buffers to store output, sum of input per feature frame,
-  // sum of squared input per feature frame respectively
-  return input->next(true, 3);
+  // Create 3 output buffers to store output, the ring of sums and sums of
+  // squares per feature frame, and their running totals respectively.
+  std::shared_ptr<ModuleProcessingState> output = input->next(true, 3);
+  const RunningSums runningSums;
+  output->buffer(1)->clear();
+  output->buffer(1)->writeZero<char>(
+      sizeof(FrameSums) * (leftContextSize_ + 1));
+  output->buffer(2)->clear();
+  output->buffer(2)->write(&runningSums, 1);
+  return output;
 }
 
 std::shared_ptr<ModuleProcessingState> LocalNorm::run(
@@ -62,46 +98,50 @@ std::shared_ptr<ModuleProcessingState> LocalNorm::run(
   assert(output->buffers().size() >= 3);
   std::shared_ptr<IOBuffer> outputBuf = output->buffer(0);
   assert(outputBuf);
-  std::shared_ptr<IOBuffer> sumBuf = output->buffer(1);
-  std::shared_ptr<IOBuffer> sqSumBuf = output->buffer(2);
-  assert(sumBuf && sqSumBuf);
+  std::shared_ptr<IOBuffer> ringBuf = output->buffer(1);
+  std::shared_ptr<IOBuffer> sumsBuf = output->buffer(2);
+  assert(ringBuf && sumsBuf);
+  const int ringSize = leftContextSize_ + 1;
+  assert(ringBuf->size<FrameSums>() == ringSize);
+  assert(sumsBuf->size<RunningSums>() == 1);
+  FrameSums* ring = ringBuf->data<FrameSums>();
+  RunningSums& sums = *sumsBuf->data<RunningSums>();
 
   const int outputSize = nFeatFrames * featureSize_;
   outputBuf->ensure<float>(outputSize);
+  const float* inPtr = inputBuf->data<float>();
+  float* outPtr = outputBuf->tail<float>();
 
+  // The window is the current frame and up to leftContextSize_ frames before
+  // it. Each frame adds its sums to the totals and removes the oldest ones.
   for (int t = 0; t < nFeatFrames; ++t) {
-    const float* inPtr = inputBuf->data<float>();
-    float* outPtr = outputBuf->tail<float>();
-
-    float curSum = std::accumulate(inPtr, inPtr + featureSize_, 0.0);
-    float curSqSum =
-        std::inner_product(inPtr, inPtr + featureSize_, inPtr, 0.0);
-    sumBuf->write(&curSum, 1);
-    sqSumBuf->write(&curSqSum, 1);
-
-    int totalSize = sumBuf->size<float>();
-    assert(totalSize == sqSumBuf->size<float>());
-    float totalSum = std::accumulate(
-        sumBuf->data<float>(), sumBuf->data<float>() + totalSize, 0.0);
-    float totalSqSum = std::accumulate(
-        sqSumBuf->data<float>(), sqSumBuf->data<float>() + totalSize, 0.0);
-
-    float mean = totalSum / (totalSize * featureSize_);
-    float stddev =
-        std::sqrt(totalSqSum / (totalSize * featureSize_) - mean * mean);
-
+    FrameSums& frame = ring[(sums.head + sums.count) % ringSize];
+    sumAndSquaredSum(inPtr, featureSize_, frame.sum, frame.sqSum);
+    sums.sum.add(frame.sum);
+    sums.sqSum.add(frame.sqSum);
+    ++sums.count;
+
+    const double n = static_cast<double>(sums.count) * featureSize_;
+    const double mean = sums.sum.sum / n;
+    const double variance = std::fmax(sums.sqSum.sum / n - mean * mean, 0.0);
+    float stddev = std::sqrt(variance);
     if (stddev <= kEpsilon) {
       stddev = 1.0;
     }
     meanNormalize(inPtr, featureSize_, mean, stddev, 1.0, 0.0, outPtr);
 
-    if (totalSize > leftContextSize_) {
-      sumBuf->consume<float>(1);
-      sqSumBuf->consume<float>(1);
+    if (sums.count > leftContextSize_) {
+      const FrameSums& oldest = ring[sums.head];
+      sums.sum.add(-oldest.sum);
+      sums.sqSum.add(-oldest.sqSum);
+      sums.head = (sums.head + 1) % ringSize;
+      --sums.count;
     }
-    inputBuf->consume<float>(featureSize_);
-    outputBuf->move<float>(featureSize_);
+    inPtr += featureSize_;
+    outPtr += featureSize_;
   }
+  inputBuf->consume<float>(outputSize);
+  outputBuf->move<float>(outputSize);
   return output;
 }
 
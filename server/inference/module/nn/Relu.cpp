@@ -8,10 +8,11 @@
 #include "inference/module/nn/Relu.h"
 
 #include <cassert>
-#include <cmath>
 #include <sstream>
 #include <stdexcept>
 
+#include "inference/common/Functions.h"
+
 namespace w2l {
 namespace streaming {
 
@@ -45,10 +46,7 @@ std::shared_ptr<ModuleProcessingState> Relu::run(
 
   switch (dataType_) {
     case DataType::FLOAT: {
-      float* inputPtr = inputBuf->data<float>();
-      for (int i = 0; i < inputBuf->size<float>(); ++i) {
-        inputPtr[i] = std::fmax(inputPtr[i], 0.0);
-      }
+      relu(inputBuf->data<float>(), inputBuf->size<float>());
     } break;
     default:
       std::stringstream ss;
@@ -11,6 +11,8 @@
 #include <sstream>
 #include <stdexcept>
 
+#include "inference/common/Functions.h"
+
 namespace w2l {
 namespace streaming {
 
@@ -31,10 +33,9 @@ Residual::Residual()
 
 std::shared_ptr<ModuleProcessingState> Residual::start(
     std::shared_ptr<ModuleProcessingState> input) {
-  // add one more buffer to store a copy of input
+  // add one more buffer to store a copy of input for the skip connection. It
+  // is filled by run() and finish(), which also move the input on to module_.
   input->buffers().push_back(std::make_shared<IOBuffer>());
-  input->buffers().back()->write<char>(
-      input->buffer(0)->data<char>(), input->buffer(0)->size<char>());
 
   std::shared_ptr<ModuleProcessingState> inputCopy = identity_->start(input);
 
@@ -76,11 +77,41 @@ std::shared_ptr<ModuleProcessingState> Residual::finish(
   return identity_->finish(residualSum);
 }
 
+std::vector<std::shared_ptr<ModuleProcessingState>> Residual::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  for (auto& input : inputs) {
+    input->buffers().back()->write<char>(
+        input->buffer(0)->data<char>(), input->buffer(0)->size<char>());
+  }
+
+  std::vector<std::shared_ptr<ModuleProcessingState>> inputCopies =
+      identity_->runBatch(inputs);
+
+  std::vector<std::shared_ptr<ModuleProcessingState>> outputs =
+      module_->runBatch(inputCopies);
+  assert(outputs.size() == inputs.size());
+  std::vector<std::shared_ptr<ModuleProcessingState>> residualSums;
+  residualSums.reserve(outputs.size());
+  for (int i = 0; i < outputs.size(); ++i) {
+    std::shared_ptr<ModuleProcessingState> residualSum = outputs[i]->next();
+    assert(residualSum);
+    sum(inputs[i]->buffers().back(),
+        outputs[i]->buffer(0),
+        residualSum->buffer(0));
+    residualSums.push_back(residualSum);
+  }
+  return identity_->runBatch(residualSums);
+}
+
 void Residual::setMemoryManager(std::shared_ptr<MemoryManager> memoryManager) {
   InferenceModule::setMemoryManager(memoryManager);
   module_->setMemoryManager(memoryManager);
 }
 
+int Residual::stride() const {
+  return module_->stride();
+}
+
 std::string Residual::debugString() const {
   std::stringstream ss;
   ss << "Residual: { ";
@@ -95,18 +126,11 @@ void Residual::sum(
     std::shared_ptr<IOBuffer> bufC) const {
   switch (dataType_) {
     case DataType::FLOAT: {
-      float* aPtr = bufA->data<float>();
-      float* bPtr = bufB->data<float>();
-
       auto len = std::min(bufA->size<float>(), bufB->size<float>());
-      bufC->ensure<float>(len);
-      float* cPtr = bufC->tail<float>();
-      for (int i = 0; i < len; ++i) {
-        cPtr[i] = aPtr[i] + bPtr[i];
-      }
+      addInPlace(bufA->data<float>(), len, bufB->data<float>());
       bufA->consume<float>(len);
-      bufB->consume<float>(len);
-      bufC->move<float>(len);
+      // Usually all of bufB is summed and its storage is handed over.
+      bufC->splice<float>(*bufB, len);
     } break;
     default:
       std::stringstream ss;
@@ -35,10 +35,20 @@ class Residual : public InferenceModule {
   std::shared_ptr<ModuleProcessingState> finish(
       std::shared_ptr<ModuleProcessingState> input) override;
 
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
   void setMemoryManager(std::shared_ptr<MemoryManager> memoryManager) override;
 
+  int stride() const override;
+
   std::string debugString() const override;
 
+  std::shared_ptr<InferenceModule> module() const {
+    return module_;
+  }
+
  protected:
   std::shared_ptr<InferenceModule> module_;
   DataType dataType_;
@@ -57,7 +67,7 @@ class Residual : public InferenceModule {
        identity_);
   }
 
-  // bufC = bufA + bufB
+  // bufC = bufA + bufB, summed in place in bufB and spliced into bufC.
   void sum(
       std::shared_ptr<IOBuffer> bufA,
       std::shared_ptr<IOBuffer> bufB,
@@ -35,6 +35,7 @@ std::shared_ptr<ModuleProcessingState> Sequential::start(
 
 std::shared_ptr<ModuleProcessingState> Sequential::run(
     std::shared_ptr<ModuleProcessingState> input) {
+  MemoryManager::RunScope runScope(memoryManager_.get());
   std::shared_ptr<ModuleProcessingState> intermediateInput = input;
   for (auto& module : modules_) {
     assert(module);
@@ -45,6 +46,7 @@ std::shared_ptr<ModuleProcessingState> Sequential::run(
 
 std::shared_ptr<ModuleProcessingState> Sequential::finish(
     std::shared_ptr<ModuleProcessingState> input) {
+  MemoryManager::RunScope runScope(memoryManager_.get());
   std::shared_ptr<ModuleProcessingState> intermediateInput = input;
   for (auto& module : modules_) {
     assert(module);
@@ -53,6 +55,18 @@ std::shared_ptr<ModuleProcessingState> Sequential::finish(
   return intermediateInput;
 }
 
+std::vector<std::shared_ptr<ModuleProcessingState>> Sequential::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  MemoryManager::RunScope runScope(memoryManager_.get());
+  std::vector<std::shared_ptr<ModuleProcessingState>> intermediateInputs =
+      inputs;
+  for (auto& module : modules_) {
+    assert(module);
+    intermediateInputs = module->runBatch(intermediateInputs);
+  }
+  return intermediateInputs;
+}
+
 void Sequential::setMemoryManager(
     std::shared_ptr<MemoryManager> memoryManager) {
   InferenceModule::setMemoryManager(memoryManager);
@@ -61,6 +75,14 @@ void Sequential::setMemoryManager(
   }
 }
 
+int Sequential::stride() const {
+  int totalStride = 1;
+  for (const auto& module : modules_) {
+    totalStride *= module->stride();
+  }
+  return totalStride;
+}
+
 std::string Sequential::debugString() const {
   std::stringstream ss;
   ss << "Sequential: { \n";
@@ -29,6 +29,10 @@ class Sequential : public InferenceModule {
 
   void add(std::shared_ptr<InferenceModule> module);
 
+  const std::vector<std::shared_ptr<InferenceModule>>& modules() const {
+    return modules_;
+  }
+
   std::shared_ptr<ModuleProcessingState> start(
       std::shared_ptr<ModuleProcessingState> input) override;
 
@@ -38,8 +42,14 @@ class Sequential : public InferenceModule {
   std::shared_ptr<ModuleProcessingState> finish(
       std::shared_ptr<ModuleProcessingState> input) override;
 
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
   void setMemoryManager(std::shared_ptr<MemoryManager> memoryManager) override;
 
+  int stride() const override;
+
   virtual std::string debugString() const override;
 
  protected:
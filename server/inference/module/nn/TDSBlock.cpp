@@ -68,15 +68,76 @@ TDSBlock::TDSBlock(
 
   add(std::make_shared<Residual>(linearSeq, residualDataType_));
   add(layernorm2);
+  fuse();
 }
 
 TDSBlock::TDSBlock()
     : reluDataType_(DataType::UNINITIALIZED),
       residualDataType_(DataType::UNINITIALIZED) {}
 
+void TDSBlock::fuse() {
+  fused_ = nullptr;
+  if (reluDataType_ != DataType::FLOAT ||
+      residualDataType_ != DataType::FLOAT || modules_.size() != 4) {
+    return;
+  }
+  auto residual1 = std::dynamic_pointer_cast<Residual>(modules_[0]);
+  auto layernorm1 = std::dynamic_pointer_cast<LayerNorm>(modules_[1]);
+  auto residual2 = std::dynamic_pointer_cast<Residual>(modules_[2]);
+  auto layernorm2 = std::dynamic_pointer_cast<LayerNorm>(modules_[3]);
+  if (!residual1 || !layernorm1 || !residual2 || !layernorm2) {
+    return;
+  }
+  auto convSeq = std::dynamic_pointer_cast<Sequential>(residual1->module());
+  auto linearSeq = std::dynamic_pointer_cast<Sequential>(residual2->module());
+  if (!convSeq || convSeq->modules().size() != 2 || !linearSeq ||
+      linearSeq->modules().size() != 3 ||
+      !std::dynamic_pointer_cast<Relu>(convSeq->modules()[1]) ||
+      !std::dynamic_pointer_cast<Relu>(linearSeq->modules()[1])) {
+    return;
+  }
+  auto conv = std::dynamic_pointer_cast<Conv1d>(convSeq->modules()[0]);
+  auto linear1 = std::dynamic_pointer_cast<Linear>(linearSeq->modules()[0]);
+  auto linear2 = std::dynamic_pointer_cast<Linear>(linearSeq->modules()[2]);
+  if (!conv || !linear1 || !linear2) {
+    return;
+  }
+  fused_ = createTDSBlockFused(conv, layernorm1, linear1, linear2, layernorm2);
+  if (fused_) {
+    fused_->setMemoryManager(memoryManager_);
+  }
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlock::start(
+    std::shared_ptr<ModuleProcessingState> input) {
+  return fused_ ? fused_->start(input) : Sequential::start(input);
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlock::run(
+    std::shared_ptr<ModuleProcessingState> input) {
+  return fused_ ? fused_->run(input) : Sequential::run(input);
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlock::finish(
+    std::shared_ptr<ModuleProcessingState> input) {
+  return fused_ ? fused_->finish(input) : Sequential::finish(input);
+}
+
+std::vector<std::shared_ptr<ModuleProcessingState>> TDSBlock::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  return fused_ ? fused_->runBatch(inputs) : Sequential::runBatch(inputs);
+}
+
+void TDSBlock::setMemoryManager(std::shared_ptr<MemoryManager> memoryManager) {
+  Sequential::setMemoryManager(memoryManager);
+  if (fused_) {
+    fused_->setMemoryManager(memoryManager);
+  }
+}
+
 std::string TDSBlock::debugString() const {
   std::stringstream ss;
-  ss << "TDSBlock: { \n";
+  ss << "TDSBlock: { " << (fused_ ? "fused " : "") << "\n";
   ss << Sequential::debugString() << "\n";
   ss << "}";
   return ss.str();
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <cereal/access.hpp>
+#include <cereal/cereal.hpp>
 #include <cereal/types/polymorphic.hpp>
 #include <cstdio>
 #include <memory>
@@ -22,6 +23,19 @@
 namespace w2l {
 namespace streaming {
 
+// The createTDSBlockFused() function returns a module that computes a
+// TDSBlock of these modules in a single pass, using the backend determined by
+// compile time configuration. Returns nullptr when the backend has no fused
+// kernel for their shapes or types.
+std::shared_ptr<InferenceModule> createTDSBlockFused(
+    std::shared_ptr<Conv1d> conv,
+    std::shared_ptr<LayerNorm> layernorm1,
+    std::shared_ptr<Linear> linear1,
+    std::shared_ptr<Linear> linear2,
+    std::shared_ptr<LayerNorm> layernorm2);
+
+// Runs a fused kernel when the backend provides one for the block. The
+// module graph is still serialized unfused, so the format does not change.
 class TDSBlock : public Sequential {
  public:
   explicit TDSBlock(
@@ -35,8 +49,27 @@ class TDSBlock : public Sequential {
 
   virtual ~TDSBlock() override = default;
 
+  std::shared_ptr<ModuleProcessingState> start(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  std::shared_ptr<ModuleProcessingState> run(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  std::shared_ptr<ModuleProcessingState> finish(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
+  void setMemoryManager(std::shared_ptr<MemoryManager> memoryManager) override;
+
   std::string debugString() const override;
 
+  bool isFused() const {
+    return fused_ != nullptr;
+  }
+
  protected:
   DataType reluDataType_;
   DataType residualDataType_;
@@ -46,13 +79,29 @@ class TDSBlock : public Sequential {
 
   TDSBlock(); // Used by Cereal for serialization.
 
+  // Sets fused_ if modules_ has the layout built by the constructor and the
+  // backend can fuse it.
+  void fuse();
+
   template <class Archive>
-  void serialize(Archive& ar) {
+  void save(Archive& ar) const {
     ar(cereal::base_class<Sequential>(this), reluDataType_, residualDataType_);
   }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    ar(cereal::base_class<Sequential>(this), reluDataType_, residualDataType_);
+    fuse();
+  }
+
+  std::shared_ptr<InferenceModule> fused_;
 };
 
 } // namespace streaming
 } // namespace w2l
 
 CEREAL_REGISTER_TYPE(w2l::streaming::TDSBlock);
+// Sequential::serialize() is inherited, pick the save/load pair.
+CEREAL_SPECIALIZE_FOR_ALL_ARCHIVES(
+    w2l::streaming::TDSBlock,
+    cereal::specialization::member_load_save);
@@ -100,7 +100,6 @@ std::shared_ptr<ModuleProcessingState> Conv1dFbGemm::finish(
   return run(input);
 }
 
-namespace {
 void unfoldDepthwise(
     float* dst,
     const float* src,
@@ -120,7 +119,6 @@ void unfoldDepthwise(
     }
   }
 }
-} // namespace
 
 std::shared_ptr<ModuleProcessingState> Conv1dFbGemm::run(
     std::shared_ptr<ModuleProcessingState> input) {
@@ -157,8 +155,10 @@ std::shared_ptr<ModuleProcessingState> Conv1dFbGemm::run(
   if (!memoryManager_) {
     throw std::invalid_argument("null memoryManager_ at Conv1dFbGemm::run()");
   }
-  auto workspace = memoryManager_->makeShared<float>(
-      (kernelSize_ * inChannels_ * outChannels_ * nOutFrames) / groups_);
+  // Every output frame unfolds into groups_ rows of
+  // kernelSize_ * inChannels_ / groups_ values.
+  auto workspace =
+      memoryManager_->makeUnique<float>(kernelSize_ * inChannels_ * nOutFrames);
   assert(workspace);
 
   unfoldDepthwise(
@@ -184,6 +184,93 @@ std::shared_ptr<ModuleProcessingState> Conv1dFbGemm::run(
   return output;
 }
 
+std::vector<std::shared_ptr<ModuleProcessingState>> Conv1dFbGemm::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  std::vector<std::shared_ptr<ModuleProcessingState>> outputs;
+  outputs.reserve(inputs.size());
+  std::vector<int> nOutFrames(inputs.size(), 0);
+  int totalOutFrames = 0;
+  int nActiveStreams = 0;
+  for (int i = 0; i < inputs.size(); ++i) {
+    assert(inputs[i]);
+    assert(!inputs[i]->buffers().empty());
+    outputs.push_back(inputs[i]->next());
+    assert(outputs.back());
+    const int nInFrames = inputs[i]->buffer(0)->size<float>() / inChannels_;
+    if (nInFrames >= kernelSize_) {
+      nOutFrames[i] = (nInFrames - kernelSize_) / stride_ + 1;
+      totalOutFrames += nOutFrames[i];
+      ++nActiveStreams;
+    }
+  }
+
+  // Stacking costs a scatter copy, it pays off only when the weights are
+  // shared by more than one stream.
+  if (nActiveStreams <= 1) {
+    for (auto& input : inputs) {
+      run(input);
+    }
+    return outputs;
+  }
+
+  if (!memoryManager_) {
+    throw std::invalid_argument(
+        "null memoryManager_ at Conv1dFbGemm::runBatch()");
+  }
+  // Every output frame unfolds into groups_ rows of
+  // kernelSize_ * inChannels_ / groups_ values.
+  auto workspace = memoryManager_->makeUnique<float>(
+      kernelSize_ * inChannels_ * totalOutFrames);
+  auto outWorkspace =
+      memoryManager_->makeUnique<float>(outChannels_ * totalOutFrames);
+  assert(workspace && outWorkspace);
+
+  float* unfoldPtr = workspace.get();
+  for (int i = 0; i < inputs.size(); ++i) {
+    if (nOutFrames[i] == 0) {
+      continue;
+    }
+    unfoldDepthwise(
+        unfoldPtr /* dst */,
+        inputs[i]->buffer(0)->data<float>() /* src */,
+        inChannels_ / groups_,
+        kernelSize_,
+        stride_,
+        nOutFrames[i],
+        groups_);
+    unfoldPtr += kernelSize_ * inChannels_ * nOutFrames[i];
+  }
+  for (int i = 0; i < totalOutFrames * groups_; ++i) {
+    std::copy_n(
+        bias_->buffer_.data<float>(),
+        outChannels_ / groups_,
+        outWorkspace.get() + i * (outChannels_ / groups_));
+  }
+
+  constexpr float beta = 1.0;
+  cblas_gemm_compute(
+      fbgemm::matrix_op_t::NoTranspose,
+      totalOutFrames * groups_,
+      workspace.get(),
+      *packedWeights_,
+      beta,
+      outWorkspace.get());
+
+  const float* outPtr = outWorkspace.get();
+  for (int i = 0; i < inputs.size(); ++i) {
+    if (nOutFrames[i] == 0) {
+      continue;
+    }
+    assert(!outputs[i]->buffers().empty());
+    const int outSize = nOutFrames[i] * outChannels_;
+    outputs[i]->buffer(0)->write<float>(outPtr, outSize);
+    inputs[i]->buffer(0)->consume<float>(
+        nOutFrames[i] * stride_ * inChannels_);
+    outPtr += outSize;
+  }
+  return outputs;
+}
+
 std::shared_ptr<Conv1d> createConv1d(
     int inChannels,
     int outChannels,
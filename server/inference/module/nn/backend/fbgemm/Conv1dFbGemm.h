@@ -23,6 +23,18 @@
 namespace w2l {
 namespace streaming {
 
+// Unfolds outDim output frames of src into GEMM rows of
+// kernelSize * inChannels values, depth rows per frame. inChannels is the
+// number of channels per group and depth the number of groups.
+void unfoldDepthwise(
+    float* dst,
+    const float* src,
+    int inChannels,
+    int kernelSize,
+    int stride,
+    int outDim,
+    int depth);
+
 class Conv1dFbGemm : public Conv1d {
  public:
   // weights is freed after we read its content into internal float 16 packed
@@ -46,6 +58,12 @@ class Conv1dFbGemm : public Conv1d {
   std::shared_ptr<ModuleProcessingState> run(
       std::shared_ptr<ModuleProcessingState> input) override;
 
+  // Unfolds the frames of all streams into one workspace and runs a single
+  // GEMM.
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
   std::shared_ptr<ModuleProcessingState> finish(
       std::shared_ptr<ModuleProcessingState> input) override;
 
@@ -59,6 +77,7 @@ class Conv1dFbGemm : public Conv1d {
 
  private:
   friend class cereal::access;
+  friend class TDSBlockFused;
 
   Conv1dFbGemm(); // Used by Cereal for serialization.
 
@@ -102,6 +102,79 @@ std::shared_ptr<ModuleProcessingState> LinearFbGemm::run(
   return output;
 }
 
+std::vector<std::shared_ptr<ModuleProcessingState>> LinearFbGemm::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  std::vector<std::shared_ptr<ModuleProcessingState>> outputs;
+  outputs.reserve(inputs.size());
+  std::vector<int> nFrames(inputs.size(), 0);
+  int totalFrames = 0;
+  int nActiveStreams = 0;
+  for (int i = 0; i < inputs.size(); ++i) {
+    assert(inputs[i]);
+    assert(inputs[i]->buffers().size() == 1);
+    outputs.push_back(inputs[i]->next());
+    assert(outputs.back());
+    nFrames[i] = inputs[i]->buffer(0)->size<float>() / nInput_;
+    totalFrames += nFrames[i];
+    if (nFrames[i] > 0) {
+      ++nActiveStreams;
+    }
+  }
+
+  // Stacking costs a gather and a scatter copy, it pays off only when the
+  // weights are shared by more than one stream.
+  if (nActiveStreams <= 1) {
+    for (auto& input : inputs) {
+      run(input);
+    }
+    return outputs;
+  }
+
+  if (!memoryManager_) {
+    throw std::invalid_argument(
+        "null memoryManager_ at LinearFbGemm::runBatch()");
+  }
+  auto inWorkspace = memoryManager_->makeUnique<float>(totalFrames * nInput_);
+  auto outWorkspace =
+      memoryManager_->makeUnique<float>(totalFrames * nOutput_);
+  assert(inWorkspace && outWorkspace);
+
+  float* inPtr = inWorkspace.get();
+  for (int i = 0; i < inputs.size(); ++i) {
+    const int inSize = nFrames[i] * nInput_;
+    std::copy_n(inputs[i]->buffer(0)->data<float>(), inSize, inPtr);
+    inPtr += inSize;
+  }
+  for (int t = 0; t < totalFrames; ++t) {
+    std::copy_n(
+        bias_->buffer_.data<float>(),
+        nOutput_,
+        outWorkspace.get() + t * nOutput_);
+  }
+
+  constexpr float beta = 1.0;
+  cblas_gemm_compute(
+      fbgemm::matrix_op_t::Transpose,
+      totalFrames,
+      inWorkspace.get(),
+      *packedWeights_,
+      beta,
+      outWorkspace.get());
+
+  const float* outPtr = outWorkspace.get();
+  for (int i = 0; i < inputs.size(); ++i) {
+    if (nFrames[i] == 0) {
+      continue;
+    }
+    assert(outputs[i]->buffers().size() == 1);
+    const int outSize = nFrames[i] * nOutput_;
+    outputs[i]->buffer(0)->write<float>(outPtr, outSize);
+    inputs[i]->buffer(0)->consume<float>(nFrames[i] * nInput_);
+    outPtr += outSize;
+  }
+  return outputs;
+}
+
 std::shared_ptr<Linear> createLinear(
     int nInput,
     int nOutput,
@@ -38,6 +38,11 @@ class LinearFbGemm : public Linear {
   std::shared_ptr<ModuleProcessingState> run(
       std::shared_ptr<ModuleProcessingState> input) override;
 
+  // Stacks the frames of all streams and runs a single GEMM.
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
   std::string debugString() const override;
   std::string debugStringWithContent() const override;
 
@@ -50,6 +55,7 @@ class LinearFbGemm : public Linear {
 
  private:
   friend class cereal::access;
+  friend class TDSBlockFused;
 
   LinearFbGemm(); // Used by Cereal for serialization.
 
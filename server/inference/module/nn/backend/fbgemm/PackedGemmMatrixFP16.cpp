@@ -7,6 +7,10 @@
 
 #include "inference/module/nn/backend/fbgemm/PackedGemmMatrixFP16.h"
 
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
 namespace w2l {
 namespace streaming {
 
@@ -36,5 +40,25 @@ std::string debugString(
   return ss.str();
 }
 
+void checkPackedLayout(int blockColSize, int kernelNumColBlocks) {
+  // The column blocking follows the SIMD width of the CPU, probe it once.
+  static const std::pair<int, int> expected = []() {
+    constexpr float alpha = 1.0;
+    const float one = 1.0;
+    fbgemm::PackedGemmMatrixFP16 probe(
+        fbgemm::matrix_op_t::NoTranspose, 1, 1, alpha, &one);
+    return std::make_pair(probe.blockColSize(), probe.kernelNumColBlocks());
+  }();
+  if (blockColSize != expected.first ||
+      kernelNumColBlocks != expected.second) {
+    std::stringstream ss;
+    ss << "checkPackedLayout(blockColSize=" << blockColSize
+       << " kernelNumColBlocks=" << kernelNumColBlocks
+       << ") packed for another CPU, this one uses blockColSize="
+       << expected.first << " kernelNumColBlocks=" << expected.second;
+    throw std::runtime_error(ss.str());
+  }
+}
+
 } // namespace streaming
 } // namespace w2l
@@ -19,12 +19,47 @@
 #include <cereal/types/vector.hpp>
 #include <fbgemm/FbgemmFP16.h>
 
+#include "inference/module/MappedModel.h"
+
+namespace w2l {
+namespace streaming {
+
+std::string debugString(
+    const fbgemm::PackedGemmMatrixFP16& packedMatrix,
+    bool dumpContent = false);
+
+// Throws if a matrix packed with these block parameters can not be used by the
+// fbgemm kernels of this CPU.
+void checkPackedLayout(int blockColSize, int kernelNumColBlocks);
+
+} // namespace streaming
+} // namespace w2l
+
 namespace cereal {
 
 template <typename Archive>
 void save(
     Archive& ar,
     const std::shared_ptr<fbgemm::PackedGemmMatrixFP16>& packedMatrix) {
+  // Mapped model: the packed matrix goes to the blob section as is.
+  if (w2l::streaming::MappedModelWriter* writer =
+          w2l::streaming::currentMappedModelWriter()) {
+    const uint64_t matSize = packedMatrix->matSize();
+    const uint64_t offset = writer->addBlob(
+        packedMatrix->pmat(), matSize * sizeof(fbgemm::float16));
+    ar(static_cast<int32_t>(packedMatrix->numRows()),
+       static_cast<int32_t>(packedMatrix->numCols()),
+       static_cast<int32_t>(packedMatrix->blockRowSize()),
+       static_cast<int32_t>(packedMatrix->lastBrow()),
+       static_cast<int32_t>(packedMatrix->blockColSize()),
+       static_cast<int32_t>(packedMatrix->numBrow()),
+       static_cast<int32_t>(packedMatrix->numBcol()),
+       static_cast<int32_t>(packedMatrix->kernelNumColBlocks()),
+       matSize,
+       offset);
+    return;
+  }
+
   const uint nElements = packedMatrix->matSize();
   std::vector<fbgemm::float16> tempBuf(nElements);
   // PackedGemmMatrixFP16::unpack() does not change the state of the object's
@@ -49,6 +84,50 @@ template <typename Archive>
 void load(
     Archive& ar,
     std::shared_ptr<fbgemm::PackedGemmMatrixFP16>& packedMatrix) {
+  // Mapped model: the matrix points into the mapping, which it keeps alive.
+  if (w2l::streaming::MappedModelReader* reader =
+          w2l::streaming::currentMappedModelReader()) {
+    int32_t numRows = 0;
+    int32_t numCols = 0;
+    int32_t blockRowSize = 0;
+    int32_t lastBrow = 0;
+    int32_t blockColSize = 0;
+    int32_t numBrow = 0;
+    int32_t numBcol = 0;
+    int32_t kernelNumColBlocks = 0;
+    uint64_t matSize = 0;
+    uint64_t offset = 0;
+    ar(numRows,
+       numCols,
+       blockRowSize,
+       lastBrow,
+       blockColSize,
+       numBrow,
+       numBcol,
+       kernelNumColBlocks,
+       matSize,
+       offset);
+    w2l::streaming::checkPackedLayout(blockColSize, kernelNumColBlocks);
+    // fbgemm only reads matrices that were passed in packed.
+    void* pmat = const_cast<void*>(
+        reader->blob(offset, matSize * sizeof(fbgemm::float16)));
+    std::shared_ptr<const void> mapping = reader->mapping();
+    packedMatrix = std::shared_ptr<fbgemm::PackedGemmMatrixFP16>(
+        new fbgemm::PackedGemmMatrixFP16(
+            numRows,
+            numCols,
+            blockRowSize,
+            lastBrow,
+            blockColSize,
+            numBrow,
+            numBcol,
+            matSize,
+            kernelNumColBlocks,
+            pmat),
+        [mapping](fbgemm::PackedGemmMatrixFP16* matrix) { delete matrix; });
+    return;
+  }
+
   int numRows = 0;
   int numCols = 0;
 
@@ -87,13 +166,3 @@ void load(
 }
 
 } // namespace cereal
-
-namespace w2l {
-namespace streaming {
-
-std::string debugString(
-    const fbgemm::PackedGemmMatrixFP16& packedMatrix,
-    bool dumpContent = false);
-
-}
-} // namespace w2l
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "inference/module/nn/backend/fbgemm/TDSBlockFused.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+
+#include "inference/common/Functions.h"
+#include "inference/module/nn/TDSBlock.h"
+
+namespace {
+constexpr const float kEpsilon = 1e-5; // min stddev to avoid division by zero
+
+// Same as LayerNorm::run() for a single frame, in and out may alias.
+void layerNorm(
+    const float* in,
+    int size,
+    float alpha,
+    float beta,
+    float* out) {
+  float mean = 0.0, stddev = 0.0;
+  w2l::streaming::meanAndStddev(in, size, mean, stddev);
+  if (stddev <= kEpsilon) {
+    stddev = 1.0;
+  }
+  w2l::streaming::meanNormalize(in, size, mean, stddev, alpha, beta, out);
+}
+} // namespace
+
+namespace w2l {
+namespace streaming {
+
+TDSBlockFused::TDSBlockFused(
+    std::shared_ptr<Conv1dFbGemm> conv,
+    std::shared_ptr<LayerNorm> layernorm1,
+    std::shared_ptr<LinearFbGemm> linear1,
+    std::shared_ptr<LinearFbGemm> linear2,
+    std::shared_ptr<LayerNorm> layernorm2)
+    : conv_(conv),
+      layernorm1_(layernorm1),
+      linear1_(linear1),
+      linear2_(linear2),
+      layernorm2_(layernorm2),
+      channels_(conv ? conv->outChannels_ : 0),
+      hidden_(linear1 ? linear1->nOutput_ : 0),
+      kernelSize_(conv ? conv->kernelSize_ : 0),
+      groups_(conv ? conv->groups_ : 0),
+      skipFrames_(conv ? conv->leftPadding_ : 0) {
+  if (!conv || !layernorm1 || !linear1 || !linear2 || !layernorm2 ||
+      !canFuse(*conv, *layernorm1, *linear1, *linear2, *layernorm2)) {
+    std::stringstream ss;
+    ss << "Invalid modules at TDSBlockFused::TDSBlockFused(conv="
+       << (conv ? conv->debugString() : "nullptr") << " layernorm1="
+       << (layernorm1 ? layernorm1->debugString() : "nullptr")
+       << " linear1=" << (linear1 ? linear1->debugString() : "nullptr")
+       << " linear2=" << (linear2 ? linear2->debugString() : "nullptr")
+       << " layernorm2="
+       << (layernorm2 ? layernorm2->debugString() : "nullptr") << ")";
+    throw std::invalid_argument(ss.str());
+  }
+}
+
+bool TDSBlockFused::canFuse(
+    const Conv1dFbGemm& conv,
+    const LayerNorm& layernorm1,
+    const LinearFbGemm& linear1,
+    const LinearFbGemm& linear2,
+    const LayerNorm& layernorm2) {
+  const uint32_t channels = conv.outChannels_;
+  return conv.packedWeights_ && conv.bias_ && linear1.packedWeights_ &&
+      linear1.bias_ && linear2.packedWeights_ && linear2.bias_ &&
+      conv.stride_ == 1 && conv.inChannels_ == channels &&
+      conv.groups_ > 0 && channels % conv.groups_ == 0 &&
+      conv.leftPadding_ + conv.rightPadding_ + 1 == conv.kernelSize_ &&
+      layernorm1.featureSize_ == channels && linear1.nInput_ == channels &&
+      linear2.nInput_ == linear1.nOutput_ && linear2.nOutput_ == channels &&
+      layernorm2.featureSize_ == channels;
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlockFused::start(
+    std::shared_ptr<ModuleProcessingState> input) {
+  if (conv_->leftPadding_ > 0) {
+    assert(input);
+    assert(!input->buffers().empty());
+    std::shared_ptr<IOBuffer> inputBuf = input->buffer(0);
+    assert(inputBuf);
+
+    IOBuffer tempBuf = *inputBuf;
+    inputBuf->clear();
+    inputBuf->writeZero<float>(conv_->leftPadding_ * channels_);
+    inputBuf->write<float>(tempBuf.data<float>(), tempBuf.size<float>());
+  }
+  return input->next(true, 1);
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlockFused::finish(
+    std::shared_ptr<ModuleProcessingState> input) {
+  if (conv_->rightPadding_ > 0) {
+    assert(input);
+    assert(!input->buffers().empty());
+    std::shared_ptr<IOBuffer> inputBuf = input->buffer(0);
+    assert(inputBuf);
+    inputBuf->writeZero<float>(conv_->rightPadding_ * channels_);
+  }
+  return run(input);
+}
+
+std::shared_ptr<ModuleProcessingState> TDSBlockFused::run(
+    std::shared_ptr<ModuleProcessingState> input) {
+  return runBatch({input}).front();
+}
+
+std::vector<std::shared_ptr<ModuleProcessingState>> TDSBlockFused::runBatch(
+    const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs) {
+  MemoryManager::RunScope runScope(memoryManager_.get());
+  std::vector<std::shared_ptr<ModuleProcessingState>> outputs;
+  outputs.reserve(inputs.size());
+  std::vector<int> nOutFrames(inputs.size(), 0);
+  int totalOutFrames = 0;
+  for (int i = 0; i < inputs.size(); ++i) {
+    assert(inputs[i]);
+    assert(!inputs[i]->buffers().empty());
+    outputs.push_back(inputs[i]->next());
+    assert(outputs.back());
+    const int nInFrames = inputs[i]->buffer(0)->size<float>() / channels_;
+    if (nInFrames >= kernelSize_) {
+      nOutFrames[i] = nInFrames - kernelSize_ + 1;
+      totalOutFrames += nOutFrames[i];
+      // Before taking pointers, ensure() may move the buffer.
+      outputs[i]->buffer(0)->ensure<float>(nOutFrames[i] * channels_);
+    }
+  }
+  if (totalOutFrames == 0) {
+    return outputs;
+  }
+
+  std::vector<const float*> windows;
+  std::vector<float*> outPtrs;
+  windows.reserve(totalOutFrames);
+  outPtrs.reserve(totalOutFrames);
+  for (int i = 0; i < inputs.size(); ++i) {
+    const float* inPtr = inputs[i]->buffer(0)->data<float>();
+    float* outPtr = outputs[i]->buffer(0)->tail<float>();
+    for (int t = 0; t < nOutFrames[i]; ++t) {
+      windows.push_back(inPtr + t * channels_);
+      outPtrs.push_back(outPtr + t * channels_);
+    }
+  }
+
+  process(windows, outPtrs);
+
+  for (int i = 0; i < inputs.size(); ++i) {
+    if (nOutFrames[i] == 0) {
+      continue;
+    }
+    outputs[i]->buffer(0)->move<float>(nOutFrames[i] * channels_);
+    inputs[i]->buffer(0)->consume<float>(nOutFrames[i] * channels_);
+  }
+  return outputs;
+}
+
+void TDSBlockFused::process(
+    const std::vector<const float*>& windows,
+    const std::vector<float*>& outputs) {
+  if (!memoryManager_) {
+    throw std::invalid_argument("null memoryManager_ at TDSBlockFused::run()");
+  }
+  const int nFrames = windows.size();
+  const int tileFrames = std::min(nFrames, kTileFrames);
+  const int groupChannels = channels_ / groups_;
+  auto unfolded =
+      memoryManager_->makeUnique<float>(tileFrames * kernelSize_ * channels_);
+  auto convOut = memoryManager_->makeUnique<float>(tileFrames * channels_);
+  auto hiddenOut = memoryManager_->makeUnique<float>(tileFrames * hidden_);
+  auto linearOut = memoryManager_->makeUnique<float>(tileFrames * channels_);
+  assert(unfolded && convOut && hiddenOut && linearOut);
+
+  const float* convBias = conv_->bias_->buffer_.data<float>();
+  const float* linear1Bias = linear1_->bias_->buffer_.data<float>();
+  const float* linear2Bias = linear2_->bias_->buffer_.data<float>();
+  constexpr float beta = 1.0;
+
+  for (int t0 = 0; t0 < nFrames; t0 += tileFrames) {
+    const int n = std::min(tileFrames, nFrames - t0);
+
+    // h = LayerNorm1(x + Relu(Conv(x))), kept in convOut.
+    for (int i = 0; i < n; ++i) {
+      unfoldDepthwise(
+          unfolded.get() + i * kernelSize_ * channels_ /* dst */,
+          windows[t0 + i] /* src */,
+          groupChannels,
+          kernelSize_,
+          /* stride */ 1,
+          /* outDim */ 1,
+          groups_);
+    }
+    for (int i = 0; i < n * groups_; ++i) {
+      std::copy_n(convBias, groupChannels, convOut.get() + i * groupChannels);
+    }
+    cblas_gemm_compute(
+        fbgemm::matrix_op_t::NoTranspose,
+        n * groups_,
+        unfolded.get(),
+        *conv_->packedWeights_,
+        beta,
+        convOut.get());
+    for (int i = 0; i < n; ++i) {
+      float* h = convOut.get() + i * channels_;
+      relu(h, channels_);
+      addInPlace(windows[t0 + i] + skipFrames_ * channels_, channels_, h);
+      layerNorm(h, channels_, layernorm1_->alpha_, layernorm1_->beta_, h);
+    }
+
+    // Relu(Linear1(h)) in hiddenOut.
+    for (int i = 0; i < n; ++i) {
+      std::copy_n(linear1Bias, hidden_, hiddenOut.get() + i * hidden_);
+    }
+    cblas_gemm_compute(
+        fbgemm::matrix_op_t::Transpose,
+        n,
+        convOut.get(),
+        *linear1_->packedWeights_,
+        beta,
+        hiddenOut.get());
+    relu(hiddenOut.get(), n * hidden_);
+
+    // y = LayerNorm2(h + Linear2(hidden)), written to the output buffers.
+    for (int i = 0; i < n; ++i) {
+      std::copy_n(linear2Bias, channels_, linearOut.get() + i * channels_);
+    }
+    cblas_gemm_compute(
+        fbgemm::matrix_op_t::Transpose,
+        n,
+        hiddenOut.get(),
+        *linear2_->packedWeights_,
+        beta,
+        linearOut.get());
+    for (int i = 0; i < n; ++i) {
+      float* y = linearOut.get() + i * channels_;
+      addInPlace(convOut.get() + i * channels_, channels_, y);
+      layerNorm(
+          y,
+          channels_,
+          layernorm2_->alpha_,
+          layernorm2_->beta_,
+          outputs[t0 + i]);
+    }
+  }
+}
+
+std::string TDSBlockFused::debugString() const {
+  std::stringstream ss;
+  ss << "TDSBlockFused:{channels=" << channels_ << " hidden=" << hidden_
+     << " kernelSize=" << kernelSize_ << " groups=" << groups_
+     << " tileFrames=" << kTileFrames << "}";
+  return ss.str();
+}
+
+std::shared_ptr<InferenceModule> createTDSBlockFused(
+    std::shared_ptr<Conv1d> conv,
+    std::shared_ptr<LayerNorm> layernorm1,
+    std::shared_ptr<Linear> linear1,
+    std::shared_ptr<Linear> linear2,
+    std::shared_ptr<LayerNorm> layernorm2) {
+  auto convFbGemm = std::dynamic_pointer_cast<Conv1dFbGemm>(conv);
+  auto linear1FbGemm = std::dynamic_pointer_cast<LinearFbGemm>(linear1);
+  auto linear2FbGemm = std::dynamic_pointer_cast<LinearFbGemm>(linear2);
+  if (!convFbGemm || !layernorm1 || !linear1FbGemm || !linear2FbGemm ||
+      !layernorm2 ||
+      !TDSBlockFused::canFuse(
+          *convFbGemm,
+          *layernorm1,
+          *linear1FbGemm,
+          *linear2FbGemm,
+          *layernorm2)) {
+    return nullptr;
+  }
+  return std::make_shared<TDSBlockFused>(
+      convFbGemm, layernorm1, linear1FbGemm, linear2FbGemm, layernorm2);
+}
+
+} // namespace streaming
+} // namespace w2l
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inference/module/InferenceModule.h"
+#include "inference/module/ModuleProcessingState.h"
+#include "inference/module/nn/LayerNorm.h"
+#include "inference/module/nn/backend/fbgemm/Conv1dFbGemm.h"
+#include "inference/module/nn/backend/fbgemm/LinearFbGemm.h"
+
+namespace w2l {
+namespace streaming {
+
+// Computes a TDSBlock in one pass over tiles of kTileFrames frames:
+//   h = LayerNorm1(x + Relu(Conv(x)))
+//   y = LayerNorm2(h + Linear2(Relu(Linear1(h))))
+// Bias, ReLU, residual add and layer norm are applied while the GEMM output
+// of a tile is in cache, and y is written straight into the output buffer.
+// The arithmetic is the same as in the unfused modules, so results match them
+// up to the row blocking of the GEMM.
+//
+// Created by TDSBlock at load time and never serialized. The modules passed
+// in keep owning the packed weights.
+class TDSBlockFused : public InferenceModule {
+ public:
+  static constexpr int kTileFrames = 16;
+
+  TDSBlockFused(
+      std::shared_ptr<Conv1dFbGemm> conv,
+      std::shared_ptr<LayerNorm> layernorm1,
+      std::shared_ptr<LinearFbGemm> linear1,
+      std::shared_ptr<LinearFbGemm> linear2,
+      std::shared_ptr<LayerNorm> layernorm2);
+
+  virtual ~TDSBlockFused() override = default;
+
+  std::shared_ptr<ModuleProcessingState> start(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  std::shared_ptr<ModuleProcessingState> run(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  std::shared_ptr<ModuleProcessingState> finish(
+      std::shared_ptr<ModuleProcessingState> input) override;
+
+  // Tiles the frames of all streams together, so the weights are read once
+  // per batch.
+  std::vector<std::shared_ptr<ModuleProcessingState>> runBatch(
+      const std::vector<std::shared_ptr<ModuleProcessingState>>& inputs)
+      override;
+
+  std::string debugString() const override;
+
+  // Returns true if the modules have the shapes this kernel supports: a
+  // stride 1 convolution keeping the number of channels and padded to keep
+  // the number of frames, and matching layer norm and linear sizes.
+  static bool canFuse(
+      const Conv1dFbGemm& conv,
+      const LayerNorm& layernorm1,
+      const LinearFbGemm& linear1,
+      const LinearFbGemm& linear2,
+      const LayerNorm& layernorm2);
+
+ private:
+  // Computes nFrames output frames. windows[i] points to the first input
+  // frame of the convolution window of output frame i, and outputs[i] to
+  // where that frame is written.
+  void process(
+      const std::vector<const float*>& windows,
+      const std::vector<float*>& outputs);
+
+  std::shared_ptr<Conv1dFbGemm> conv_;
+  std::shared_ptr<LayerNorm> layernorm1_;
+  std::shared_ptr<LinearFbGemm> linear1_;
+  std::shared_ptr<LinearFbGemm> linear2_;
+  std::shared_ptr<LayerNorm> layernorm2_;
+  const int channels_;
+  const int hidden_;
+  const int kernelSize_;
+  const int groups_;
+  // Frames from the start of a convolution window to its residual frame.
+  const int skipFrames_;
+};
+
+} // namespace streaming
+} // namespace w2l
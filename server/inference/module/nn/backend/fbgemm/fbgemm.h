@@ -9,3 +9,4 @@
 
 #include "inference/module/nn/backend/fbgemm/Conv1dFbGemm.h"
 #include "inference/module/nn/backend/fbgemm/LinearFbGemm.h"
+#include "inference/module/nn/backend/fbgemm/TDSBlockFused.h"
@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <atomic>
 #include <csignal>
+#include <cstdlib>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include <fstream>
 #include <iostream>
 
@@ -14,6 +19,11 @@
 #include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 
+#include "inference/common/ArenaMemoryManager.h"
+#include "inference/common/Decimator.h"
+#include "inference/common/DefaultMemoryManager.h"
+#include "inference/common/Functions.h"
+#include "inference/common/PoolMemoryManager.h"
 #include "inference/module/module.h"
 #include "inference/decoder/Decoder.h"
 #include "inference/module/feature/feature.h"
@@ -32,85 +42,170 @@ struct PerSocketData {
     int status = 1;
 };
 
-uWS::WebSocket<true, true, PerSocketData> * webSocket = nullptr;
+using WebSocket = uWS::WebSocket<true, true, PerSocketData>;
+
 struct uWS::Loop *loop = nullptr;
 us_listen_socket_t * listenSocket = nullptr;
 
-void my_function(int sig){
-    loop->defer([webSocket, listenSocket]() {
-        if (webSocket) {
-            webSocket->close();
-        }
-        us_listen_socket_close(1, listenSocket);
-    });
-    wrapper->Quit();
-}
+// Loaded once and shared by all sessions: the modules keep no per-stream state,
+// everything that changes while streaming lives in ModuleProcessingState.
+std::shared_ptr<streaming::Sequential> dnnModule;
+std::shared_ptr<streaming::BatchScheduler> batchScheduler;
+std::shared_ptr<MemoryManager> memoryManager;
+std::shared_ptr<const DecoderFactory> decoderFactory;
+fl::lib::text::LexiconDecoderOptions decoderOptions;
 
-void send_payload(const char *payload) {
-    std::string message = std::string(payload);
-    loop->defer([webSocket, message]() {
-        webSocket->send(message, uWS::OpCode::TEXT);
-    });
+// Runs of frames with blank posterior above this reach the beam search as a
+// single frame, most frames of silence or pauses are skipped.
+constexpr const float blankSkipThreshold = 0.999f;
+
+// Audio samples behind each output frame of dnnModule.
+int modelStride = 1;
+
+int nTokens = 9998;
+
+constexpr const int kSampleRate = 16000;
+// Rate of the audio WebRTC hands to send_audio_data.
+constexpr const int kInputSampleRate = 48000;
+constexpr const int kFrameStrideMs = 10;
+constexpr const int kMinChunkMs = kFrameStrideMs;
+constexpr const int kMaxChunkMs = 1000;
+constexpr const int kDefaultChunkMs = kFrameStrideMs;
+
+// Chunk size requested by the client in the offer as "options": {"chunkMs": N},
+// any multiple of the 10 msec frame stride. Short chunks give low latency,
+// long chunks run more frames per model call.
+int parseChunkMs(const rapidjson::Document& json) {
+    if (!json.HasMember("options") || !json["options"].IsObject()) {
+        return kDefaultChunkMs;
+    }
+    const rapidjson::Value& options = json["options"];
+    if (!options.HasMember("chunkMs") || !options["chunkMs"].IsInt()) {
+        return kDefaultChunkMs;
+    }
+    int chunkMs = options["chunkMs"].GetInt();
+    if (chunkMs < kMinChunkMs || chunkMs > kMaxChunkMs || chunkMs % kFrameStrideMs != 0) {
+        std::cout << "Invalid chunkMs " << chunkMs << ", using " << kDefaultChunkMs << std::endl;
+        return kDefaultChunkMs;
+    }
+    return chunkMs;
 }
 
-constexpr const float kMaxUint16 = static_cast<float>(0x8000);
+// Sessions offered with "options": {"headless": true} get no video, their
+// words go out over the data channel instead.
+bool parseHeadless(const rapidjson::Document& json) {
+    if (!json.HasMember("options") || !json["options"].IsObject()) {
+        return false;
+    }
+    const rapidjson::Value& options = json["options"];
+    return options.HasMember("headless") && options["headless"].IsBool() && options["headless"].GetBool();
+}
 
-float transformationFunction(int16_t i) {
-    return static_cast<float>(i) / kMaxUint16;
+// The default "native" renderer scrolls the video frames and draws only the
+// new columns straight into I420 buffers, "options": {"renderer": "gl"}
+// renders every frame with OSMesa.
+bool parseNativeVideo(const rapidjson::Document& json) {
+    if (!json.HasMember("options") || !json["options"].IsObject()) {
+        return true;
+    }
+    const rapidjson::Value& options = json["options"];
+    return !(options.HasMember("renderer") && options["renderer"].IsString() &&
+             std::string(options["renderer"].GetString()) == "gl");
 }
 
-std::shared_ptr<streaming::Sequential> dnnModule;
-std::shared_ptr<streaming::IOBuffer> inputBuffer;
-std::shared_ptr<streaming::IOBuffer> outputBuffer;
+// Streaming state of a single client.
+struct Session {
+    explicit Session(WebSocket *ws)
+        : ws(ws),
+          decoder(decoderFactory->createDecoder(decoderOptions)),
+          decimator(kInputSampleRate / kSampleRate) {
+        input = std::make_shared<streaming::ModuleProcessingState>(1);
+        output = dnnModule->start(input);
+        inputBuffer = input->buffer(0);
+        outputBuffer = output->buffer(0);
+        // The ends of the pipeline consume from the front while appending,
+        // rings never move the data left behind. Each ring costs a memory
+        // file and three mappings, the buffers in between stay linear.
+        inputBuffer->enableRing();
+        outputBuffer->enableRing();
+        // Sized for the longest chunk up front: once a connection is open the
+        // buffers belong to its recognition tasks, and a later offer on the
+        // loop thread must not reallocate them.
+        const int maxChunkSamples = kMaxChunkMs * kSampleRate / 1000;
+        inputBuffer->reserve<float>(maxChunkSamples + modelStride);
+        outputBuffer->reserve<float>((maxChunkSamples / modelStride + 1) * nTokens);
+        decoder.setBlankSkipThreshold(blankSkipThreshold);
+        decoder.start();
+        batchScheduler->addStream();
+    }
+
+    ~Session() {
+        batchScheduler->removeStream();
+    }
 
-std::shared_ptr<streaming::ModuleProcessingState> input;
-std::shared_ptr<streaming::ModuleProcessingState> output;
+    WebSocket *ws;
 
-streaming::Decoder *decoderPtr;
+    std::shared_ptr<streaming::ModuleProcessingState> input;
+    std::shared_ptr<streaming::ModuleProcessingState> output;
 
-int nSize = 8000;
-int nTokens = 9998;
-int nFrame = 0;
+    std::shared_ptr<streaming::IOBuffer> inputBuffer;
+    std::shared_ptr<streaming::IOBuffer> outputBuffer;
 
-void softmax(const float* input, size_t size, float *output, size_t k = 3) {
+    streaming::Decoder decoder;
 
-	int i, j = 0;
-	float m, sum, constant;
+    // 48kHz int16 to the 16kHz float input of the feature module.
+    streaming::Decimator decimator;
 
-	m = -INFINITY;
-	for (i = 0; i < size; ++i) {
-		if (m < input[i]) {
-			m = input[i];
-            j = i;
-		}
-	}
+    // Set by the offer on the loop thread while a recognition task of the
+    // previous connection may still read it.
+    std::atomic<bool> headless{false};
 
-	sum = 0.0;
-	for (i = 0; i < size; ++i) {
-		sum += (float)std::exp(input[i] - m);
-	}
+    int nFrame = 0;
+};
 
-	constant = m + std::log(sum);
-    
-    std::vector<size_t> idx(size);
+// Session registry, only touched from the uWS loop thread.
+std::unordered_map<WebSocket *, std::unique_ptr<Session>> sessions;
 
-    std::iota(idx.begin(), idx.end(), 0);
+void my_function(int sig){
+    loop->defer([]() {
+        std::vector<WebSocket *> sockets;
+        for (auto& it : sessions) {
+            sockets.push_back(it.first);
+        }
+        for (auto ws : sockets) {
+            ws->close();
+        }
+        us_listen_socket_close(1, listenSocket);
+    });
+    wrapper->Quit();
+}
 
-    std::partial_sort(
-        idx.begin(),
-        idx.begin() + k,
-        idx.end(),
-        [&input](const size_t& l, const size_t& r) {
-            return input[l] > input[r];
+void send_payload(void *session, const char *payload) {
+    // Called from WebRTC threads while the connection is open, so the session
+    // is alive here, but the socket may be gone by the time the loop runs.
+    WebSocket *ws = static_cast<Session *>(session)->ws;
+    std::string message = std::string(payload);
+    loop->defer([session, ws, message]() {
+        auto it = sessions.find(ws);
+        if (it != sessions.end() && it->second.get() == session) {
+            ws->send(message, uWS::OpCode::TEXT);
         }
-    );
+    });
+}
+
+// Probability of the best token of a frame, printing the likely candidates.
+void softmax(const float* input, size_t size, float *output, int nFrame, size_t k = 3) {
+
+    float topValues[kMaxTopK];
+    int topIndices[kMaxTopK];
+    const float constant = logSumExpTopK(input, size, k, topValues, topIndices);
 
     *output = 0;
 
-	for (i = 0; i < k; ++i) {
-        j = idx[i];
+    for (size_t i = 0; i < k; ++i) {
+        int j = topIndices[i];
         if (j != 9997) {
-		    float p = (float)std::exp(input[j] - constant);
+            float p = (float)std::exp(topValues[i] - constant);
             if (i == 0) {
                 *output = p;
             }
@@ -118,49 +213,142 @@ void softmax(const float* input, size_t size, float *output, size_t k = 3) {
                 std::cout << "frame: " << nFrame << "/" << j << " (" << p << ")" << std::endl;
             }
         }
-	}
-    
-    nFrame += 1;
+    }
+}
+
+// Results of a headless session: {"type": "words", "frame": N, "words": [...]}
+void send_words(Session *session, const std::vector<WordUnit>& words) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("type");
+    writer.String("words");
+    writer.Key("frame");
+    writer.Int(session->nFrame);
+    writer.Key("words");
+    writer.StartArray();
+    for (const auto& word : words) {
+        writer.String(word.word.c_str());
+    }
+    writer.EndArray();
+    writer.EndObject();
+    if (!wrapper->SendData(session, buffer.GetString())) {
+        std::cout << "Data channel not open, words dropped" << std::endl;
+    }
 }
 
-void send_audio_data(const int16_t* audio_data, size_t data_size, float *outputs) {
-    if (data_size != nSize) {
-        return;
+size_t send_audio_data(void *sessionPtr, const int16_t* audio_data, size_t data_size, float *outputs, size_t max_outputs) {
+    if (data_size == 0) {
+        return 0;
     }
-    inputBuffer->ensure<float>(data_size);
+    Session *session = static_cast<Session *>(sessionPtr);
+    auto& inputBuffer = session->inputBuffer;
+    auto& outputBuffer = session->outputBuffer;
+    // Conversion and resampling write straight into the feature input.
+    auto& decimator = session->decimator;
+    inputBuffer->ensure<float>(decimator.outputSize(data_size));
     //std::cout << "buffer allocated" << std::endl;
-    float* inputBufferPtr = inputBuffer->data<float>();
-    std::transform(audio_data, audio_data + data_size, inputBufferPtr, transformationFunction);
+    int nSamples = decimator.process(audio_data, data_size, inputBuffer->tail<float>());
     //std::cout << "data transformed" << std::endl;
-    inputBuffer->move<float>(data_size);
+    inputBuffer->move<float>(nSamples);
     //std::cout << "audio data copied" << std::endl;
-    dnnModule->run(input);
+    batchScheduler->run(session->input);
     //std::cout << "dnn module finished" << std::endl;
     float* data = outputBuffer->data<float>();
     int size = outputBuffer->size<float>();
     //std::cout << "output buffer: " << size << std::endl;
     if (data && size > 0) {
-        decoderPtr->run(data, size);
+        session->decoder.run(data, size);
         //std::cout << "decoder finished" << std::endl;
     }
     constexpr const int lookBack = 0;
-    const std::vector<WordUnit>& words = decoderPtr->getBestHypothesisInWords(lookBack);
+    const std::vector<WordUnit>& words = session->decoder.getBestHypothesisInWords(lookBack);
     if (words.size() > 0) {
         for (const auto& word : words) {
             std::cout << "word: " << word.word << std::endl;
         }
+        if (session->headless.load(std::memory_order_relaxed)) {
+            send_words(session, words);
+        }
     }
     
     const int nFramesOut = size / nTokens;
 
     for (int i = 0; i < nFramesOut; i++) {
-        softmax(data, nTokens, &outputs[i]);
+        float unused;
+        softmax(data, nTokens, i < max_outputs ? &outputs[i] : &unused, session->nFrame++);
         data += nTokens;
     }
 
     // Consume and prune
     outputBuffer->consume<float>(nFramesOut * nTokens);
-    decoderPtr->prune(lookBack);
+    session->decoder.prune(lookBack);
+
+    return nFramesOut;
+}
+
+// Loads a module from its memory mapped copy, which is created from the cereal
+// file on first start or when it does not fit this build or CPU. Weights of the
+// mapped copy stay in the page cache and are shared by all server processes.
+std::shared_ptr<streaming::Sequential> loadModel(const std::string& path, const std::string& mappedPath) {
+    // Identifies the source the mapped model was converted from, without the
+    // source the mapped model is used as it is.
+    uint64_t sourceStamp = 0;
+    try {
+        sourceStamp = mappedModelSourceStamp(path);
+    } catch (const std::exception& e) {
+        std::cout << "Model " << path << " not checked: " << e.what() << std::endl;
+    }
+
+    try {
+        auto module = std::dynamic_pointer_cast<streaming::Sequential>(loadMappedModel(mappedPath, sourceStamp));
+        if (module) {
+            return module;
+        }
+        std::cout << "Mapped model " << mappedPath << " is not a Sequential" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Mapped model " << mappedPath << " not usable: " << e.what() << std::endl;
+    }
+
+    std::shared_ptr<streaming::Sequential> module;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + path);
+        }
+        cereal::BinaryInputArchive archive(file);
+        archive(module);
+    }
+    // A read-only or full models directory only costs the mapping
+    try {
+        saveMappedModel(module, mappedPath, sourceStamp);
+        std::cout << "Mapped model " << mappedPath << " created" << std::endl;
+        auto mapped = std::dynamic_pointer_cast<streaming::Sequential>(loadMappedModel(mappedPath, sourceStamp));
+        if (mapped) {
+            return mapped;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Mapped model " << mappedPath << " not created: " << e.what() << std::endl;
+    }
+    return module;
+}
+
+// Workspaces of the modules come from the manager named by W2L_MEMORY_MANAGER:
+// "arena" (thread-local bump allocator rewound after every pass), "pool"
+// (thread-local size-class free lists) or "default" (malloc).
+std::shared_ptr<MemoryManager> createMemoryManager() {
+    const char *name = std::getenv("W2L_MEMORY_MANAGER");
+    std::string type = name ? name : "arena";
+    if (type == "arena") {
+        return std::make_shared<ArenaMemoryManager>();
+    }
+    if (type == "pool") {
+        return std::make_shared<PoolMemoryManager>();
+    }
+    if (type != "default") {
+        std::cout << "Unknown W2L_MEMORY_MANAGER " << type << ", using default" << std::endl;
+    }
+    return std::make_shared<DefaultMemoryManager>();
 }
 
 int main() {
@@ -170,39 +358,34 @@ int main() {
     std::string modelsPath = "/home/ubuntu/wav2letter/models/";
     std::string featurePath = "feature_extractor.bin";
     std::string acousticPath = "acoustic_model.bin";
+    std::string featureMappedPath = "feature_extractor.mmap";
+    std::string acousticMappedPath = "acoustic_model.mmap";
     std::string tokensPath = "tokens.txt";
     std::string optionsPath = "decoder_options.json";
     std::string lexiconPath = "lexicon.txt";
     std::string languagePath = "language_model.bin";
 
-    std::shared_ptr<streaming::Sequential> featureModule;
-    std::shared_ptr<streaming::Sequential> acousticModule;
-
-    {
-        std::ifstream featureFile(modelsPath + featurePath, std::ios::binary);
-        if (!featureFile.is_open()) {
-            throw std::runtime_error("failed to open " + featurePath);
-        }
-        cereal::BinaryInputArchive featureArchive(featureFile);
-        featureArchive(featureModule);
-    }
-
-    {
-        std::ifstream acousticFile(modelsPath + acousticPath, std::ios::binary);
-        if (!acousticFile.is_open()) {
-            throw std::runtime_error("failed to open " + acousticPath);
-        }
-        cereal::BinaryInputArchive acousticArchive(acousticFile);
-        acousticArchive(acousticModule);
-    }
+    std::shared_ptr<streaming::Sequential> featureModule =
+        loadModel(modelsPath + featurePath, modelsPath + featureMappedPath);
+    std::shared_ptr<streaming::Sequential> acousticModule =
+        loadModel(modelsPath + acousticPath, modelsPath + acousticMappedPath);
 
     // String both models togethers to a single DNN.
     dnnModule = std::make_shared<streaming::Sequential>();
     dnnModule->add(featureModule);
     dnnModule->add(acousticModule);
 
+    memoryManager = createMemoryManager();
+    dnnModule->setMemoryManager(memoryManager);
+
     //std::cout << dnnModule->debugString() << std::endl;
 
+    // Chunks of concurrent sessions that arrive within maxWait of each other
+    // share one pass through the acoustic model.
+    constexpr const int maxBatchSize = 16;
+    constexpr const std::chrono::microseconds maxWait(2000);
+    batchScheduler = std::make_shared<streaming::BatchScheduler>(dnnModule, maxBatchSize, maxWait);
+
     //std::ifstream transitionsFile(modelsPath + transitionsPath, std::ios::binary);
     //if (!transitionsFile.is_open()) {
     //  throw std::runtime_error("failed to open " + transitionsPath);
@@ -211,7 +394,7 @@ int main() {
     //transitionsArchive(transitions);
     std::vector<float> transitions;
 
-    std::shared_ptr<const DecoderFactory> decoderFactory = std::make_shared<DecoderFactory>(
+    decoderFactory = std::make_shared<DecoderFactory>(
         modelsPath + tokensPath,
         modelsPath + lexiconPath,
         modelsPath + languagePath,
@@ -221,8 +404,6 @@ int main() {
         0
     );
 
-    fl::lib::text::LexiconDecoderOptions decoderOptions;
-
     {
         std::ifstream optionsFile(modelsPath + optionsPath);
         if (!optionsFile.is_open()) {
@@ -244,21 +425,8 @@ int main() {
         decoderOptions.criterionType = fl::lib::text::CriterionType::CTC;
     }
 
-    auto decoder = decoderFactory->createDecoder(decoderOptions);
-
-    std::cout << "Decoder created" << std::endl;
-
-    decoder.start();
-
-    decoderPtr = &decoder;
-
-    std::cout << "Decoder started" << std::endl;
-
-    input = std::make_shared<streaming::ModuleProcessingState>(1);
-    output = dnnModule->start(input);
-
-    inputBuffer = input->buffer(0);
-    outputBuffer = output->buffer(0);
+    modelStride = dnnModule->stride();
+    std::cout << "Model stride: " << modelStride << " samples" << std::endl;
 
     wrapper = std::make_shared<ConnectionWrapper>();
     //wrapper->Join();
@@ -293,12 +461,92 @@ int main() {
         res->end(stream.str());
         file.close();
 
+	}).get("/stats", [](auto *res, auto *req) {
+
+        RecognitionStats stats = wrapper->GetRecognitionStats();
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("sessions");
+        writer.Uint64(sessions.size());
+        writer.Key("recognition_threads");
+        writer.Uint64(stats.threads);
+        writer.Key("queue_depth");
+        writer.Uint64(stats.queue_depth);
+        writer.Key("tasks");
+        writer.Uint64(stats.tasks);
+        writer.Key("avg_wait_ms");
+        writer.Double(stats.avg_wait_ms);
+        writer.Key("max_wait_ms");
+        writer.Double(stats.max_wait_ms);
+        // Input formats over all sessions
+        std::vector<AudioFormatStats> formats;
+        for (auto& it : sessions) {
+            AudioFormatStats sessionFormats[16];
+            size_t n = std::min<size_t>(wrapper->GetAudioFormatStats(it.second.get(), sessionFormats, 16), 16);
+            for (size_t i = 0; i < n; i++) {
+                const AudioFormatStats& format = sessionFormats[i];
+                auto same = std::find_if(formats.begin(), formats.end(), [&](const AudioFormatStats& other) {
+                    return other.bits_per_sample == format.bits_per_sample &&
+                           other.sample_rate == format.sample_rate && other.channels == format.channels;
+                });
+                if (same == formats.end()) {
+                    formats.push_back(format);
+                } else {
+                    same->calls += format.calls;
+                    same->frames += format.frames;
+                    same->dropped += format.dropped;
+                }
+            }
+        }
+        writer.Key("audio_formats");
+        writer.StartArray();
+        for (const auto& format : formats) {
+            writer.StartObject();
+            writer.Key("bits_per_sample");
+            writer.Int(format.bits_per_sample);
+            writer.Key("sample_rate");
+            writer.Int(format.sample_rate);
+            writer.Key("channels");
+            writer.Uint64(format.channels);
+            writer.Key("calls");
+            writer.Uint64(format.calls);
+            writer.Key("frames");
+            writer.Uint64(format.frames);
+            writer.Key("dropped");
+            writer.Uint64(format.dropped);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        // Frames per second of every session with video
+        writer.Key("video_fps");
+        writer.StartArray();
+        for (auto& it : sessions) {
+            if (!it.second->headless.load(std::memory_order_relaxed)) {
+                writer.Double(wrapper->GetVideoFrameRate(it.second.get()));
+            }
+        }
+        writer.EndArray();
+        writer.Key("batching");
+        writer.String(batchScheduler->debugString().c_str());
+        writer.Key("memory");
+        writer.String(memoryManager->debugString().c_str());
+        writer.EndObject();
+        res->writeHeader("Content-Type", "application/json");
+        res->end(buffer.GetString());
+
 	}).ws<PerSocketData>("/*", {
         /* Handlers */
         .open = [](auto *ws) {
-            webSocket = ws;
+            sessions[ws] = std::make_unique<Session>(ws);
+            std::cout << "Session opened, active sessions: " << sessions.size() << std::endl;
         },
         .message = [](auto *ws, std::string_view message, uWS::OpCode opCode) {
+            auto it = sessions.find(ws);
+            if (it == sessions.end()) {
+                return;
+            }
+            Session *session = it->second.get();
             rapidjson::Document json;
             json.Parse(std::string(message).c_str());
             if (json.HasMember("type")) {
@@ -309,7 +557,16 @@ int main() {
                         if (payload.IsObject()) {
                             std::string sdp = payload["sdp"].GetString();
                             std::cout << "SDP: " << sdp << std::endl;
-                            wrapper->CreateConnection(sdp.c_str(), send_payload, send_audio_data);
+                            int chunkMs = parseChunkMs(json);
+                            std::cout << "Chunk: " << chunkMs << " ms" << std::endl;
+                            RecognitionOptions options;
+                            options.chunk_samples = chunkMs * kSampleRate / 1000;
+                            options.frame_samples = modelStride;
+                            options.headless = parseHeadless(json);
+                            session->headless.store(options.headless, std::memory_order_relaxed);
+                            options.native_video = parseNativeVideo(json);
+                            std::cout << "Headless: " << options.headless << std::endl;
+                            wrapper->CreateConnection(session, sdp.c_str(), send_payload, send_audio_data, options);
                         }
                     }
                 } else if (type == "candidate") {
@@ -319,16 +576,27 @@ int main() {
                             std::string sdp_mid = payload["sdpMid"].GetString();
                             int sdp_mline_index = payload["sdpMLineIndex"].GetInt();
                             std::string candidate = payload["candidate"].GetString();
-                            wrapper->AddCandidate(sdp_mid.c_str(), sdp_mline_index, candidate.c_str());
+                            wrapper->AddCandidate(session, sdp_mid.c_str(), sdp_mline_index, candidate.c_str());
                         }
                     }
                 }
             }
 
         },
-        .close = [](auto */*ws*/, int /*code*/, std::string_view /*message*/) {
+        .close = [](auto *ws, int /*code*/, std::string_view /*message*/) {
             /* You may access ws->getUserData() here, but sending or
              * doing any kind of I/O with the socket is not valid. */
+            auto it = sessions.find(ws);
+            if (it == sessions.end()) {
+                return;
+            }
+            // Blocks until no WebRTC callback can reach the session anymore.
+            wrapper->CloseConnection(it->second.get());
+            std::cout << "Skipped blank frames: " << it->second->decoder.skippedFrames() << "/" << it->second->nFrame << std::endl;
+            sessions.erase(it);
+            std::cout << "Session closed, active sessions: " << sessions.size() << std::endl;
+            std::cout << batchScheduler->debugString() << std::endl;
+            std::cout << memoryManager->debugString() << std::endl;
         }
     }).listen(8080, [](auto *socket) {
 	    if (socket) {
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "inference/decoder/Decoder.h"
+
+using namespace w2l::streaming;
+
+namespace {
+
+// "#" is the CTC blank and "|" the word separator.
+const std::vector<std::string> kTokens = {"#", "|", "a", "b"};
+constexpr int kBlank = 0;
+constexpr int kSilence = 1;
+
+class DecoderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::temp_directory_path() /
+        ("decoder_test_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir_);
+    {
+      std::ofstream tokens(dir_ / "tokens.txt");
+      for (const auto& token : kTokens) {
+        tokens << token << "\n";
+      }
+      std::ofstream lexicon(dir_ / "lexicon.txt");
+      lexicon << "ab a b |\n"
+              << "ba b a |\n";
+    }
+    factory_ = std::make_shared<DecoderFactory>(
+        (dir_ / "tokens.txt").string(),
+        (dir_ / "lexicon.txt").string(),
+        "",
+        std::vector<float>{},
+        fl::lib::text::SmearingMode::MAX,
+        "|",
+        0);
+
+    options_.beamSize = 16;
+    options_.beamSizeToken = static_cast<int>(kTokens.size());
+    options_.beamThreshold = 100;
+    options_.lmWeight = 0;
+    options_.wordScore = 0;
+    options_.unkScore = -10;
+    options_.silScore = 0;
+    options_.logAdd = false;
+    options_.criterionType = fl::lib::text::CriterionType::CTC;
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(dir_);
+  }
+
+  // Appends n frames where token has probability p.
+  void addFrames(int token, float p, int n) {
+    const int N = kTokens.size();
+    for (int t = 0; t < n; ++t) {
+      for (int i = 0; i < N; ++i) {
+        emissions_.push_back(
+            i == token ? std::log(p) : std::log((1 - p) / (N - 1)));
+      }
+    }
+  }
+
+  // Letters separated by long blank runs, so every word spans several
+  // chunks and the blank skipping drops most of its frames.
+  void addWord(const std::string& word) {
+    for (char letter : word) {
+      const int token = letter == 'a' ? 2 : 3;
+      addFrames(token, 0.98f, 2);
+      addFrames(kBlank, 0.9999f, 12);
+    }
+    addFrames(kSilence, 0.98f, 2);
+    addFrames(kBlank, 0.9999f, 20);
+  }
+
+  // Decodes emissions_ in chunks of chunkFrames, reading the words and
+  // pruning after every chunk the way the server does.
+  std::vector<std::string> decode(float blankSkipThreshold, int chunkFrames) {
+    const int N = kTokens.size();
+    const int T = emissions_.size() / N;
+    Decoder decoder = factory_->createDecoder(options_);
+    decoder.setBlankSkipThreshold(blankSkipThreshold);
+    decoder.start();
+
+    std::vector<std::string> transcript;
+    auto collect = [&]() {
+      for (const auto& word : decoder.getBestHypothesisInWords(0)) {
+        EXPECT_GE(word.beginTimeFrame, 0) << word.word;
+        EXPECT_LE(word.beginTimeFrame, word.endTimeFrame) << word.word;
+        // Times count from the frame before the hypothesis, and the end of
+        // the input adds one frame.
+        EXPECT_LE(word.endTimeFrame, T + 1) << word.word;
+        transcript.push_back(word.word);
+      }
+    };
+    for (int t = 0; t < T; t += chunkFrames) {
+      const int n = std::min(chunkFrames, T - t);
+      decoder.run(emissions_.data() + t * N, n * N);
+      collect();
+      decoder.prune(0);
+    }
+    decoder.finish();
+    collect();
+
+    if (blankSkipThreshold > 0) {
+      EXPECT_GT(decoder.skippedFrames(), 0);
+    }
+    return transcript;
+  }
+
+  std::filesystem::path dir_;
+  std::shared_ptr<const DecoderFactory> factory_;
+  fl::lib::text::LexiconDecoderOptions options_;
+  std::vector<float> emissions_;
+};
+
+TEST_F(DecoderTest, BlankSkippingKeepsWordsAcrossPrunes) {
+  for (const char* word : {"ab", "ba", "ab", "ba", "ab"}) {
+    addWord(word);
+  }
+  const std::vector<std::string> reference = decode(0, 5);
+  ASSERT_FALSE(reference.empty());
+  for (int chunkFrames : {1, 5, 16, 64}) {
+    EXPECT_EQ(decode(0.999f, chunkFrames), reference)
+        << "chunkFrames=" << chunkFrames;
+  }
+}
+
+} // namespace